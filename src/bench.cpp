@@ -0,0 +1,2509 @@
+/* Benchmarks for list.h
+ *
+ * Every benchmark case runs one operation on one container for a given amount
+ * of elements. The list.h macros are measured against the STL containers that
+ * do the same job, so regressions between releases show up as changes in the
+ * output.
+ *
+ * Each case runs in its own process, which makes the peak RSS reported for it
+ * independent of the cases before it. Within that process the case is run
+ * again and again, setup included, until at least BENCH_MIN_RUNS runs took
+ * the minimum time together, and the fastest measured part is reported. A single run
+ * of a small case is mostly page faults and clock overhead, the fastest of
+ * many is stable enough to compare releases. The output is one CSV line (or
+ * JSON object) per case with these fields:
+ * 	operation, container, n, ns_per_op, peak_rss_kb, allocs, frees, runs
+ *
+ * Options:
+ * 	-f csv|json	output format, CSV by default
+ * 	-n MAX		largest amount of elements, 10^6 by default
+ * 	-o FILTER	only run operations whose name contains FILTER
+ * 	-t SECONDS	minimum time spent on each case, 0.1 by default
+ *
+ * Sizes start at 10 and are multiplied by 10 until MAX is reached, so
+ * /bench -n 100000000/ covers everything from 10 to 10^8 elements.
+ *
+ * These numbers are only meaningful when compiled with optimizations, which is
+ * why the bench target of the Makefile does exactly that.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <iterator>
+#include <list>
+#include <new>
+#include <numeric>
+#include <queue>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Allocation counting
+ *
+ * The STL containers allocate through operator new, list.h through its
+ * LIST_MALLOC hooks and the benchmarks allocate their nodes with the
+ * functions below, so all of them are routed through these counters. They
+ * are atomic because the parallel benchmarks allocate from worker threads.
+ */
+static long bench_allocs;
+static long bench_frees;
+
+static void bench_count_(long *counter) {
+	__atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+static void *bench_malloc(size_t size) {
+	bench_count_(&bench_allocs);
+	return malloc(size);
+}
+
+static void *bench_calloc(size_t n, size_t size) {
+	bench_count_(&bench_allocs);
+	return calloc(n, size);
+}
+
+/* A realloc counts like a new allocation replacing the old one, which is what
+ * the STL containers do when they grow.
+ */
+static void *bench_realloc(void *p, size_t size) {
+	bench_count_(&bench_allocs);
+	if(p) bench_count_(&bench_frees);
+	return realloc(p, size);
+}
+
+static void bench_free(void *p) {
+	if(p) bench_count_(&bench_frees);
+	free(p);
+}
+
+void *operator new(size_t size) {
+	void *p;
+
+	p = bench_malloc(size);
+	if(!p) throw std::bad_alloc();
+
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	bench_free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	bench_free(p);
+}
+
+#define LIST_MALLOC(S) bench_malloc(S)
+#define LIST_CALLOC(N, S) bench_calloc(N, S)
+#define LIST_REALLOC(P, S) bench_realloc(P, S)
+#define LIST_FREE(P) bench_free(P)
+
+#include "list.h"
+#include "list.hpp"
+
+typedef void (*benchfunc_t)(long n);
+
+struct bench {
+	const char *operation;
+	const char *container;
+	benchfunc_t func;
+};
+
+struct element {
+	struct element *next;
+	struct element *prev;
+	long value;
+};
+
+struct ielement {
+	uint32_t next;
+	uint32_t prev;
+	long value;
+};
+
+struct snode {
+	struct snode *next;
+	struct snode *prev;
+	struct snode *skip[12];
+	long value;
+};
+
+static int cmp_snode(const struct snode *a, const struct snode *b) {
+	return a->value < b->value ? -1 : a->value > b->value;
+}
+
+LIST_DEFINE(element, struct element)
+SKIPLIST_DEFINE(snodes, struct snode, cmp_snode)
+
+static int cmp_long(const long *a, const long *b) {
+	return *a < *b ? -1 : *a > *b;
+}
+
+HEAP_DEFINE(heap2, long, cmp_long, 2)
+HEAP_DEFINE(heap4, long, cmp_long, 4)
+
+struct centry {
+	struct centry *next;
+	struct centry *prev;
+	long key;
+	long value;
+};
+
+#define hash_centry(E) lru_hash((E)->key)
+#define eq_centry(A, B) ((A)->key == (B)->key)
+
+LRU_DEFINE(lru, struct centry, hash_centry, eq_centry)
+
+struct wtimer {
+	struct wtimer *next;
+	struct wtimer *prev;
+	uint64_t expires;
+	unsigned gen;
+};
+
+/* Entry of the heap based timer queue, stale once the timer's gen changed */
+struct htimer {
+	uint64_t expires;
+	struct wtimer *timer;
+	unsigned gen;
+};
+
+static int cmp_htimer(const struct htimer *a, const struct htimer *b) {
+	return a->expires < b->expires ? -1 : a->expires > b->expires;
+}
+
+TIMER_WHEEL_DEFINE(wheel, struct wtimer)
+HEAP_DEFINE(timer_heap, struct htimer, cmp_htimer, 4)
+ARRAY_DEFINE(longs, long)
+UNROLLED_DEFINE(unrolled, long, unrolled_capacity(long))
+
+/* Prevents the compiler from optimizing the benchmarked work away */
+volatile long bench_sink;
+
+/* Results of the measured part of a case */
+static double bench_t0, bench_elapsed;
+static long bench_allocs0, bench_frees0;
+static long bench_ops, bench_nallocs, bench_nfrees;
+static int bench_measured;
+
+/* Repetitions of a case
+ *
+ * A case is run at least BENCH_MIN_RUNS times and until its runs took
+ * bench_min_time seconds together, setup included, but never more than
+ * BENCH_MAX_RUNS times.
+ */
+#define BENCH_MIN_RUNS 3
+#define BENCH_MAX_RUNS 100000
+static double bench_min_time = 0.1;
+
+static double now() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Start measuring
+ *
+ * Everything a case does before calling this is setup and isn't counted.
+ */
+static void bench_start() {
+	bench_allocs0 = __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED);
+	bench_frees0 = __atomic_load_n(&bench_frees, __ATOMIC_RELAXED);
+	bench_t0 = now();
+}
+
+/* Stop measuring after OPS operations
+ */
+static void bench_stop(long ops) {
+	bench_elapsed = now() - bench_t0;
+	bench_nallocs = __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED) -
+		bench_allocs0;
+	bench_nfrees = __atomic_load_n(&bench_frees, __ATOMIC_RELAXED) -
+		bench_frees0;
+	bench_ops = ops > 0 ? ops : 1;
+	bench_measured = 1;
+}
+
+/* Builds a list.h list with N calloc'd nodes */
+static struct element *build_list(long n) {
+	long i;
+	struct element *list, *node;
+
+	list = NULL;
+	for(i = 0; i < n; i++) {
+		node = (struct element*) bench_calloc(1, sizeof(struct element));
+		node->value = i;
+		list_append(&list, node);
+	}
+
+	return list;
+}
+
+static void free_list(struct element **list) {
+	struct element *node, *tmp;
+
+	list_foreach_safe(list, node, tmp) {
+		list_remove(list, node);
+		bench_free(node);
+	}
+}
+
+/* Builds a list.h list whose nodes are linked in a random order
+ *
+ * This is what long lived lists look like after many inserts and removals, the
+ * next node is hardly ever close to the current one.
+ */
+static struct element *build_scattered_list(long n) {
+	long i, j;
+	unsigned long seed;
+	struct element *list, **nodes, *tmp;
+
+	nodes = (struct element**) bench_malloc(n * sizeof(struct element*));
+	for(i = 0; i < n; i++) {
+		nodes[i] = (struct element*) bench_calloc(1, sizeof(struct element));
+		nodes[i]->value = i;
+	}
+
+	seed = 12345;
+	for(i = n - 1; i > 0; i--) {
+		seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+		j = (seed >> 33) % (i + 1);
+		tmp = nodes[i];
+		nodes[i] = nodes[j];
+		nodes[j] = tmp;
+	}
+
+	list = NULL;
+	for(i = 0; i < n; i++) list_append(&list, nodes[i]);
+	bench_free(nodes);
+
+	return list;
+}
+
+/* list.h */
+
+static void list_h_append(long n) {
+	long i;
+	struct element *list, *node;
+
+	list = NULL;
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		node = (struct element*) bench_calloc(1, sizeof(struct element));
+		node->value = i;
+		list_append(&list, node);
+	}
+	bench_stop(n);
+
+	free_list(&list);
+}
+
+static void list_h_prepend(long n) {
+	long i;
+	struct element *list, *node;
+
+	list = NULL;
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		node = (struct element*) bench_calloc(1, sizeof(struct element));
+		node->value = i;
+		list_prepend(&list, node);
+	}
+	bench_stop(n);
+
+	free_list(&list);
+}
+
+static void list_h_insert_after(long n) {
+	long i;
+	struct element *list, *node, *cursor;
+
+	list = build_list(1);
+	cursor = list;
+
+	bench_start();
+	for(i = 1; i < n; i++) {
+		node = (struct element*) bench_calloc(1, sizeof(struct element));
+		node->value = i;
+		list_insert_after(&list, node, cursor);
+		cursor = node->next;
+	}
+	bench_stop(n - 1);
+
+	free_list(&list);
+}
+
+static void list_h_remove(long n) {
+	long i;
+	struct element *list, *node;
+
+	list = build_list(n);
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		node = list;
+		list_remove(&list, node);
+		bench_free(node);
+	}
+	bench_stop(n);
+}
+
+static void list_h_teardown(long n) {
+	struct element *list;
+
+	list = build_list(n);
+
+	bench_start();
+	free_list(&list);
+	bench_stop(n);
+}
+
+static void list_h_iterate(long n) {
+	long sum;
+	struct element *list, *node;
+
+	list = build_list(n);
+
+	bench_start();
+	sum = 0;
+	list_foreach(&list, node) sum += node->value;
+	bench_stop(n);
+
+	bench_sink = sum;
+	free_list(&list);
+}
+
+static void list_h_iterate_reverse(long n) {
+	long sum;
+	struct element *list, *node;
+
+	list = build_list(n);
+
+	bench_start();
+	sum = 0;
+	list_foreach_reverse(&list, node) sum += node->value;
+	bench_stop(n);
+
+	bench_sink = sum;
+	free_list(&list);
+}
+
+/* Pseudo random values so every container sorts the same sequence */
+static long random_value(long i) {
+	return (i * 2654435761L) % 1000003L;
+}
+
+static int cmp_element(const void *a, const void *b) {
+	long va, vb;
+
+	va = ((const struct element*) a)->value;
+	vb = ((const struct element*) b)->value;
+
+	return (va > vb) - (va < vb);
+}
+
+static void list_h_sort(long n) {
+	long i;
+	struct element *list, *node;
+
+	list = build_list(n);
+	i = 0;
+	list_foreach(&list, node) node->value = random_value(i++);
+
+	bench_start();
+	list_sort(&list, cmp_element);
+	bench_stop(n);
+
+	free_list(&list);
+}
+
+static void list_h_merge_sorted(long n) {
+	long i;
+	struct element *a, *b, *node;
+
+	a = build_list(n / 2);
+	b = build_list(n - n / 2);
+	i = 0;
+	list_foreach(&a, node) node->value = 2 * i++;
+	i = 0;
+	list_foreach(&b, node) node->value = 2 * i++ + 1;
+
+	bench_start();
+	list_merge_sorted(&a, &b, cmp_element);
+	bench_stop(n);
+
+	free_list(&a);
+}
+
+static void list_h_concat(long n) {
+	struct element *a, *b;
+
+	a = build_list(1);
+	b = build_list(n);
+
+	bench_start();
+	list_concat(&a, &b);
+	bench_stop(n);
+
+	free_list(&a);
+}
+
+/* What moving a batch between lists costs without list_concat */
+static void list_h_concat_per_node(long n) {
+	struct element *a, *b, *node;
+
+	a = build_list(1);
+	b = build_list(n);
+
+	bench_start();
+	while(b) {
+		node = b;
+		list_remove(&b, node);
+		list_append(&a, node);
+	}
+	bench_stop(n);
+
+	free_list(&a);
+}
+
+static void list_h_split(long n) {
+	long i;
+	struct element *list, *out, *at;
+
+	list = build_list(n);
+	out = NULL;
+	at = list;
+	for(i = 0; i < n / 2; i++) at = at->next;
+
+	bench_start();
+	list_split(&list, at, &out);
+	bench_stop(n - n / 2);
+
+	list_concat(&list, &out);
+	free_list(&list);
+}
+
+/* Work queues between threads
+ *
+ * QUEUE_PRODUCERS threads push n nodes in total while the main thread takes
+ * them out in batches, once through a lock-free list_mpsc and once through a
+ * list guarded by a mutex.
+ */
+#define QUEUE_PRODUCERS 4
+
+struct queue {
+	struct list_mpsc mpsc;
+	pthread_mutex_t lock;
+	struct element *locked;
+};
+
+struct producer {
+	struct queue *queue;
+	struct element *nodes;
+	long count;
+};
+
+static void *mpsc_producer(void *arg) {
+	long i;
+	struct producer *p;
+
+	p = (struct producer*) arg;
+	for(i = 0; i < p->count; i++) list_mpsc_push(&p->queue->mpsc, &p->nodes[i]);
+
+	return NULL;
+}
+
+static void *mutex_producer(void *arg) {
+	long i;
+	struct producer *p;
+	struct element *node;
+
+	p = (struct producer*) arg;
+	for(i = 0; i < p->count; i++) {
+		node = &p->nodes[i];
+		pthread_mutex_lock(&p->queue->lock);
+		list_append(&p->queue->locked, node);
+		pthread_mutex_unlock(&p->queue->lock);
+	}
+
+	return NULL;
+}
+
+static void queue_run(long n, int lockfree) {
+	int i;
+	long received;
+	pthread_t threads[QUEUE_PRODUCERS];
+	struct producer producers[QUEUE_PRODUCERS];
+	struct queue queue;
+	struct element *nodes, *batch, *node, *tmp;
+
+	nodes = (struct element*) bench_calloc(n, sizeof(struct element));
+	list_mpsc_init(&queue.mpsc, struct element);
+	pthread_mutex_init(&queue.lock, NULL);
+	queue.locked = NULL;
+	batch = NULL;
+
+	bench_start();
+	for(i = 0; i < QUEUE_PRODUCERS; i++) {
+		producers[i].queue = &queue;
+		producers[i].nodes = nodes + n / QUEUE_PRODUCERS * i;
+		producers[i].count = n / QUEUE_PRODUCERS;
+		if(i == QUEUE_PRODUCERS - 1) producers[i].count += n % QUEUE_PRODUCERS;
+		pthread_create(&threads[i], NULL,
+				lockfree ? mpsc_producer : mutex_producer, &producers[i]);
+	}
+
+	received = 0;
+	while(received < n) {
+		if(lockfree) {
+			list_mpsc_pop_all(&queue.mpsc, &batch);
+		}
+		else {
+			pthread_mutex_lock(&queue.lock);
+			list_concat(&batch, &queue.locked);
+			pthread_mutex_unlock(&queue.lock);
+		}
+
+		list_foreach_safe(&batch, node, tmp) {
+			list_remove(&batch, node);
+			received++;
+		}
+	}
+
+	for(i = 0; i < QUEUE_PRODUCERS; i++) pthread_join(threads[i], NULL);
+	bench_stop(n);
+
+	pthread_mutex_destroy(&queue.lock);
+	bench_free(nodes);
+}
+
+static void queue_mpsc(long n) {
+	queue_run(n, 1);
+}
+
+static void queue_mutex(long n) {
+	queue_run(n, 0);
+}
+
+/* list.h functions generated by LIST_DEFINE and ARRAY_DEFINE */
+
+static void typed_append(long n) {
+	long i;
+	struct element *list, *node;
+
+	list = NULL;
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		node = (struct element*) bench_calloc(1, sizeof(struct element));
+		node->value = i;
+		element_append(&list, node);
+	}
+	bench_stop(n);
+
+	free_list(&list);
+}
+
+static void typed_iterate(long n) {
+	long sum;
+	struct element *list, *node;
+
+	list = build_list(n);
+
+	bench_start();
+	sum = 0;
+	for(node = element_first(list); node; node = element_next(list, node))
+		sum += node->value;
+	bench_stop(n);
+
+	bench_sink = sum;
+	free_list(&list);
+}
+
+static void typed_iterate_reverse(long n) {
+	long sum;
+	struct element *list, *node;
+
+	list = build_list(n);
+
+	bench_start();
+	sum = 0;
+	for(node = element_last(list); node; node = element_prev(list, node))
+		sum += node->value;
+	bench_stop(n);
+
+	bench_sink = sum;
+	free_list(&list);
+}
+
+static void typed_array_append(long n) {
+	long i;
+	long *vals;
+
+	vals = longs_new();
+
+	bench_start();
+	for(i = 0; i < n; i++) longs_append(&vals, i);
+	bench_stop(n);
+
+	longs_free(vals);
+}
+
+/* list.h unrolled lists */
+
+static void unrolled_append_bench(long n) {
+	long i;
+	struct unrolled *list;
+
+	list = NULL;
+
+	bench_start();
+	for(i = 0; i < n; i++) unrolled_append(&list, i);
+	bench_stop(n);
+
+	unrolled_free(&list);
+}
+
+static void unrolled_insert_bench(long n) {
+	long i;
+	struct unrolled *list, *cursor;
+
+	list = NULL;
+	unrolled_append(&list, 0);
+	cursor = list;
+
+	bench_start();
+	for(i = 1; i < n; i++) {
+		unrolled_insert(&list, cursor, cursor->count / 2, i);
+		cursor = cursor->next;
+	}
+	bench_stop(n - 1);
+
+	unrolled_free(&list);
+}
+
+static void unrolled_iterate(long n) {
+	int j;
+	long i, sum;
+	struct unrolled *list, *node;
+
+	list = NULL;
+	for(i = 0; i < n; i++) unrolled_append(&list, i);
+
+	bench_start();
+	sum = 0;
+	unrolled_foreach(&list, node, j) sum += node->items[j];
+	bench_stop(n);
+
+	bench_sink = sum;
+	unrolled_free(&list);
+}
+
+static void unrolled_iterate_reverse(long n) {
+	int j;
+	long i, sum;
+	struct unrolled *list, *node;
+
+	list = NULL;
+	for(i = 0; i < n; i++) unrolled_append(&list, i);
+
+	bench_start();
+	sum = 0;
+	unrolled_foreach_reverse(&list, node, j) sum += node->items[j];
+	bench_stop(n);
+
+	bench_sink = sum;
+	unrolled_free(&list);
+}
+
+/* list.h index lists */
+
+static void ilist_append_bench(long n) {
+	long i;
+	uint32_t list, free_nodes, idx;
+	struct ielement *nodes;
+
+	array_new(&nodes, struct ielement);
+	list = ilist_null;
+	free_nodes = ilist_null;
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		ilist_alloc(nodes, &free_nodes, idx);
+		nodes[idx].value = i;
+		ilist_append(nodes, &list, idx);
+	}
+	bench_stop(n);
+
+	array_free(nodes);
+}
+
+static struct ielement *build_ilist(long n, uint32_t *list) {
+	long i;
+	uint32_t free_nodes, idx;
+	struct ielement *nodes;
+
+	array_new(&nodes, struct ielement);
+	*list = ilist_null;
+	free_nodes = ilist_null;
+
+	for(i = 0; i < n; i++) {
+		ilist_alloc(nodes, &free_nodes, idx);
+		nodes[idx].value = i;
+		ilist_append(nodes, list, idx);
+	}
+
+	return nodes;
+}
+
+static void ilist_iterate(long n) {
+	long sum;
+	uint32_t list, idx;
+	struct ielement *nodes;
+
+	nodes = build_ilist(n, &list);
+
+	bench_start();
+	sum = 0;
+	ilist_foreach(nodes, &list, idx) sum += nodes[idx].value;
+	bench_stop(n);
+
+	bench_sink = sum;
+	array_free(nodes);
+}
+
+static void ilist_iterate_reverse(long n) {
+	long sum;
+	uint32_t list, idx;
+	struct ielement *nodes;
+
+	nodes = build_ilist(n, &list);
+
+	bench_start();
+	sum = 0;
+	ilist_foreach_reverse(nodes, &list, idx) sum += nodes[idx].value;
+	bench_stop(n);
+
+	bench_sink = sum;
+	array_free(nodes);
+}
+
+/* Iterating lists of scattered nodes with and without prefetching */
+
+static void scattered_iterate(long n) {
+	long sum;
+	struct element *list, *node;
+
+	list = build_scattered_list(n);
+
+	bench_start();
+	sum = 0;
+	list_foreach(&list, node) sum += node->value;
+	bench_stop(n);
+
+	bench_sink = sum;
+	free_list(&list);
+}
+
+/* The scattered list after list_compact, which frees the old nodes */
+static void free_moved(void *from, void *, void *) {
+	bench_free(from);
+}
+
+static void scattered_iterate_compacted(long n) {
+	long sum;
+	struct element *list, *node;
+	struct list_pool *pool;
+
+	list = build_scattered_list(n);
+	pool = list_compact(&list, sizeof(struct element), free_moved, NULL);
+
+	bench_start();
+	sum = 0;
+	list_foreach(&list, node) sum += node->value;
+	bench_stop(n);
+
+	bench_sink = sum;
+	list_pool_free_list(&list, pool);
+}
+
+static void scattered_compact(long n) {
+	struct element *list;
+	struct list_pool *pool;
+
+	list = build_scattered_list(n);
+
+	bench_start();
+	pool = list_compact(&list, sizeof(struct element), free_moved, NULL);
+	bench_stop(n);
+
+	bench_sink = list->value;
+	list_pool_free_list(&list, pool);
+}
+
+static void scattered_iterate_prefetch(long n) {
+	long sum;
+	struct element *list, *node;
+
+	list = build_scattered_list(n);
+
+	bench_start();
+	sum = 0;
+	list_foreach_prefetch(&list, node, 8) sum += node->value;
+	bench_stop(n);
+
+	bench_sink = sum;
+	free_list(&list);
+}
+
+static void scattered_iterate_reverse(long n) {
+	long sum;
+	struct element *list, *node;
+
+	list = build_scattered_list(n);
+
+	bench_start();
+	sum = 0;
+	list_foreach_reverse(&list, node) sum += node->value;
+	bench_stop(n);
+
+	bench_sink = sum;
+	free_list(&list);
+}
+
+static void scattered_iterate_prefetch_reverse(long n) {
+	long sum;
+	struct element *list, *node;
+
+	list = build_scattered_list(n);
+
+	bench_start();
+	sum = 0;
+	list_foreach_prefetch_reverse(&list, node, 8) sum += node->value;
+	bench_stop(n);
+
+	bench_sink = sum;
+	free_list(&list);
+}
+
+/* list.h with nodes from a pool */
+
+static void pool_append(long n) {
+	long i;
+	struct list_pool *pool;
+	struct element *list, *node;
+
+	list = NULL;
+
+	bench_start();
+	pool = list_pool_new(struct element, 4096);
+	for(i = 0; i < n; i++) {
+		node = (struct element*) list_pool_alloc(pool);
+		node->value = i;
+		list_append(&list, node);
+	}
+	bench_stop(n);
+
+	list_pool_free_list(&list, pool);
+}
+
+static void pool_teardown(long n) {
+	long i;
+	struct list_pool *pool;
+	struct element *list, *node;
+
+	list = NULL;
+	pool = list_pool_new(struct element, 4096);
+	for(i = 0; i < n; i++) {
+		node = (struct element*) list_pool_alloc(pool);
+		list_append(&list, node);
+	}
+
+	bench_start();
+	list_pool_free_list(&list, pool);
+	bench_stop(n);
+}
+
+static void pool_iterate(long n) {
+	long i, sum;
+	struct list_pool *pool;
+	struct element *list, *node;
+
+	list = NULL;
+	pool = list_pool_new(struct element, 4096);
+	for(i = 0; i < n; i++) {
+		node = (struct element*) list_pool_alloc(pool);
+		node->value = i;
+		list_append(&list, node);
+	}
+
+	bench_start();
+	sum = 0;
+	list_foreach(&list, node) sum += node->value;
+	bench_stop(n);
+
+	bench_sink = sum;
+	list_pool_free_list(&list, pool);
+}
+
+/* list.h dynamic arrays */
+
+static void dyn_array_append(long n) {
+	long i;
+	long *vals;
+
+	array_new(&vals, long);
+
+	bench_start();
+	for(i = 0; i < n; i++) array_append(vals, i);
+	bench_stop(n);
+
+	array_free(vals);
+}
+
+static void dyn_array_append_half(long n) {
+	long i;
+	long *vals;
+
+	array_new(&vals, long);
+	array_set_growth(vals, ARRAY_GROW_HALF, 0, 0);
+
+	bench_start();
+	for(i = 0; i < n; i++) array_append(vals, i);
+	bench_stop(n);
+
+	array_free(vals);
+}
+
+static void dyn_array_reserve(long n) {
+	long i;
+	long *vals;
+
+	array_new(&vals, long);
+
+	bench_start();
+	array_reserve(vals, n);
+	for(i = 0; i < n; i++) array_append(vals, i);
+	bench_stop(n);
+
+	array_free(vals);
+}
+
+static void dyn_array_iterate(long n) {
+	long i, sum;
+	long *vals;
+
+	array_new(&vals, long);
+	for(i = 0; i < n; i++) array_append(vals, i);
+
+	bench_start();
+	sum = 0;
+	for(i = 0; i < (long) array_len(vals); i++) sum += vals[i];
+	bench_stop(n);
+
+	bench_sink = sum;
+	array_free(vals);
+}
+
+static void dyn_array_iterate_reverse(long n) {
+	long i, sum;
+	long *vals;
+
+	array_new(&vals, long);
+	for(i = 0; i < n; i++) array_append(vals, i);
+
+	bench_start();
+	sum = 0;
+	for(i = (long) array_len(vals) - 1; i >= 0; i--) sum += vals[i];
+	bench_stop(n);
+
+	bench_sink = sum;
+	array_free(vals);
+}
+
+/* list.hpp
+ *
+ * The C++ wrappers should cost nothing over the macros. Their dyn_array runs
+ * the same STL container templates as std::vector further down.
+ */
+
+typedef circularlist::circular_list<struct element> hpp_list;
+typedef circularlist::dyn_array<long> hpp_array;
+
+static void hpp_append(long n) {
+	long i;
+	struct element *node;
+	hpp_list list;
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		node = (struct element*) bench_calloc(1, sizeof(struct element));
+		node->value = i;
+		list.push_back(*node);
+	}
+	bench_stop(n);
+
+	free_list(&list.head());
+}
+
+static void hpp_iterate(long n) {
+	long sum;
+	hpp_list list(build_list(n));
+
+	bench_start();
+	sum = 0;
+	for(struct element &node : list) sum += node.value;
+	bench_stop(n);
+
+	bench_sink = sum;
+	free_list(&list.head());
+}
+
+static void hpp_iterate_reverse(long n) {
+	long sum;
+	hpp_list list(build_list(n));
+
+	bench_start();
+	sum = 0;
+	for(hpp_list::reverse_iterator it = list.rbegin(); it != list.rend(); ++it)
+		sum += it->value;
+	bench_stop(n);
+
+	bench_sink = sum;
+	free_list(&list.head());
+}
+
+/* Sorted containers
+ *
+ * Inserting random values into a sorted container and looking up random
+ * values in it. The plain list has to scan for the position, so its cases
+ * stop at 10^5 elements.
+ */
+#define SORTED_SCAN_MAX 100000
+
+static void list_h_sorted_insert(long n) {
+	long i;
+	struct element *list, *node, *pos;
+
+	if(n > SORTED_SCAN_MAX) return;
+	list = NULL;
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		node = (struct element*) bench_calloc(1, sizeof(struct element));
+		node->value = random_value(i);
+		list_foreach(&list, pos) if(pos->value > node->value) break;
+		if(!pos) {
+			list_append(&list, node);
+		}
+		else if(pos == list) {
+			list_prepend(&list, node);
+		}
+		else {
+			list_insert_before(&list, node, pos);
+		}
+	}
+	bench_stop(n);
+
+	free_list(&list);
+}
+
+static void skiplist_sorted_insert(long n) {
+	long i;
+	struct snodes s;
+	struct snode *nodes;
+
+	memset(&s, 0, sizeof(s));
+	nodes = (struct snode*) bench_calloc(n, sizeof(struct snode));
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		nodes[i].value = random_value(i);
+		snodes_insert(&s, nodes + i);
+	}
+	bench_stop(n);
+
+	bench_free(nodes);
+}
+
+static void multiset_sorted_insert(long n) {
+	long i;
+	std::multiset<long> c;
+
+	bench_start();
+	for(i = 0; i < n; i++) c.insert(random_value(i));
+	bench_stop(n);
+}
+
+static void list_h_lower_bound(long n) {
+	long i, sum;
+	struct element *list, *node, *pos;
+
+	if(n > SORTED_SCAN_MAX) return;
+	list = NULL;
+	for(i = 0; i < n; i++) {
+		node = (struct element*) bench_calloc(1, sizeof(struct element));
+		node->value = i * 16;
+		list_append(&list, node);
+	}
+	sum = 0;
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		list_foreach(&list, pos) if(pos->value >= random_value(i)) break;
+		sum += pos ? pos->value : 0;
+	}
+	bench_stop(n);
+
+	bench_sink = sum;
+	free_list(&list);
+}
+
+static void skiplist_lower_bound(long n) {
+	long i, sum;
+	struct snodes s;
+	struct snode *nodes, *pos, key;
+
+	memset(&s, 0, sizeof(s));
+	nodes = (struct snode*) bench_calloc(n, sizeof(struct snode));
+	for(i = 0; i < n; i++) {
+		nodes[i].value = random_value(i);
+		snodes_insert(&s, nodes + i);
+	}
+	sum = 0;
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		key.value = random_value(i * 7);
+		pos = snodes_lower_bound(&s, &key);
+		sum += pos ? pos->value : 0;
+	}
+	bench_stop(n);
+
+	bench_sink = sum;
+	bench_free(nodes);
+}
+
+static void multiset_lower_bound(long n) {
+	long i, sum;
+	std::multiset<long> c;
+	std::multiset<long>::iterator pos;
+
+	for(i = 0; i < n; i++) c.insert(random_value(i));
+	sum = 0;
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		pos = c.lower_bound(random_value(i * 7));
+		sum += pos != c.end() ? *pos : 0;
+	}
+	bench_stop(n);
+
+	bench_sink = sum;
+}
+
+/* Priority queues
+ *
+ * Pushing n random values and popping all of them again, or building a heap
+ * from n random values at once.
+ */
+template<void (*PUSH)(long**, long), long (*POP)(long**)>
+static void heap_push_pop(long n) {
+	long i, sum, *h;
+
+	array_new(&h, long);
+	sum = 0;
+
+	bench_start();
+	for(i = 0; i < n; i++) PUSH(&h, random_value(i));
+	for(i = 0; i < n; i++) sum += POP(&h);
+	bench_stop(2 * n);
+
+	bench_sink = sum;
+	array_free(h);
+}
+
+static void priority_queue_push_pop(long n) {
+	long i, sum;
+	std::priority_queue<long, std::vector<long>, std::greater<long> > c;
+
+	sum = 0;
+
+	bench_start();
+	for(i = 0; i < n; i++) c.push(random_value(i));
+	for(i = 0; i < n; i++) {
+		sum += c.top();
+		c.pop();
+	}
+	bench_stop(2 * n);
+
+	bench_sink = sum;
+}
+
+template<void (*HEAPIFY)(long*)>
+static void heap_heapify(long n) {
+	long i, *h;
+
+	array_new(&h, long);
+	for(i = 0; i < n; i++) array_append(h, random_value(i));
+
+	bench_start();
+	HEAPIFY(h);
+	bench_stop(n);
+
+	bench_sink = h[0];
+	array_free(h);
+}
+
+static void vector_make_heap(long n) {
+	long i;
+	std::vector<long> c;
+
+	for(i = 0; i < n; i++) c.push_back(random_value(i));
+
+	bench_start();
+	std::make_heap(c.begin(), c.end(), std::greater<long>());
+	bench_stop(n);
+
+	bench_sink = c[0];
+}
+
+/* LRU caches
+ *
+ * Looking up n keys drawn from a Zipfian distribution (theta 0.99, like YCSB)
+ * over n different keys in a cache holding a tenth of them. Every miss puts
+ * the key into the cache, reusing the evicted entry once the cache is full.
+ */
+#define LRU_THETA 0.99
+
+/* Draws N keys from 0 to N - 1, small keys being the most popular ones */
+static long *zipf_keys(long n) {
+	long i, *keys;
+	double zetan, zeta2, alpha, eta, u, uz;
+	unsigned long seed;
+
+	zetan = 0;
+	for(i = 1; i <= n; i++) zetan += 1 / pow(i, LRU_THETA);
+	zeta2 = 1 + 1 / pow(2, LRU_THETA);
+	alpha = 1 / (1 - LRU_THETA);
+	eta = (1 - pow(2.0 / n, 1 - LRU_THETA)) / (1 - zeta2 / zetan);
+
+	keys = (long*) bench_malloc(n * sizeof(long));
+	seed = 12345;
+	for(i = 0; i < n; i++) {
+		seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+		u = (seed >> 11) * (1.0 / 9007199254740992.0);
+		uz = u * zetan;
+		if(uz < 1) keys[i] = 0;
+		else if(uz < zeta2) keys[i] = 1;
+		else keys[i] = (long) (n * pow(eta * u - eta + 1, alpha)) % n;
+	}
+
+	return keys;
+}
+
+static long lru_capacity(long n) {
+	return n / 10 > 0 ? n / 10 : 1;
+}
+
+static void lru_cache_zipf(long n) {
+	long i, used, sum, *keys;
+	struct lru c;
+	struct centry *entries, *e, *spare, key;
+
+	keys = zipf_keys(n);
+	entries = (struct centry*) bench_calloc(lru_capacity(n) + 1, sizeof(*e));
+	lru_init(&c, lru_capacity(n));
+	spare = NULL;
+	used = sum = 0;
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		key.key = keys[i];
+		if((e = lru_get(&c, &key))) {
+			sum += e->value;
+			continue;
+		}
+		e = spare ? spare : &entries[used++];
+		e->key = e->value = keys[i];
+		spare = lru_put(&c, e);
+	}
+	bench_stop(n);
+
+	bench_sink = sum;
+	lru_free(&c);
+	bench_free(entries);
+	bench_free(keys);
+}
+
+static void list_h_unordered_map_zipf(long n) {
+	long i, cap, used, sum, *keys;
+	struct centry *entries, *list, *e;
+	std::unordered_map<long, struct centry*> map;
+	std::unordered_map<long, struct centry*>::iterator it;
+
+	keys = zipf_keys(n);
+	cap = lru_capacity(n);
+	entries = (struct centry*) bench_calloc(cap, sizeof(*e));
+	map.reserve(cap);
+	list = NULL;
+	used = sum = 0;
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		it = map.find(keys[i]);
+		if(it != map.end()) {
+			e = it->second;
+			list_remove(&list, e);
+			list_prepend(&list, e);
+			sum += e->value;
+			continue;
+		}
+		if(used == cap) {
+			e = list->prev;
+			list_remove(&list, e);
+			map.erase(e->key);
+		}
+		else {
+			e = &entries[used++];
+		}
+		e->key = e->value = keys[i];
+		list_prepend(&list, e);
+		map.emplace(keys[i], e);
+	}
+	bench_stop(n);
+
+	bench_sink = sum;
+	bench_free(entries);
+	bench_free(keys);
+}
+
+static void std_list_unordered_map_zipf(long n) {
+	long i, cap, sum, *keys;
+	std::list<std::pair<long, long> > c;
+	std::unordered_map<long, std::list<std::pair<long, long> >::iterator> map;
+	std::unordered_map<long, std::list<std::pair<long, long> >::iterator>::iterator it;
+
+	keys = zipf_keys(n);
+	cap = lru_capacity(n);
+	map.reserve(cap);
+	sum = 0;
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		it = map.find(keys[i]);
+		if(it != map.end()) {
+			c.splice(c.begin(), c, it->second);
+			sum += it->second->second;
+			continue;
+		}
+		if((long) c.size() == cap) {
+			map.erase(c.back().first);
+			c.splice(c.begin(), c, std::prev(c.end()));
+			c.front() = std::make_pair(keys[i], keys[i]);
+		}
+		else {
+			c.emplace_front(keys[i], keys[i]);
+		}
+		map.emplace(keys[i], c.begin());
+	}
+	bench_stop(n);
+
+	bench_sink = sum;
+	bench_free(keys);
+}
+
+/* Timer queues
+ *
+ * n live timers expiring within the next n ticks. timer_expire lets all of
+ * them expire while time moves on one tick at a time. timer_reset moves time
+ * on by one tick per operation and each operation cancels a random timer and
+ * schedules it again, like a connection timeout that is reset on traffic.
+ * Expired timers are scheduled again right away. The heap marks cancelled
+ * timers as stale and drops them when they get to the top.
+ */
+static uint64_t timer_random(unsigned long *seed, long n) {
+	*seed = *seed * 6364136223846793005UL + 1442695040888963407UL;
+	return (*seed >> 33) % n;
+}
+
+static void wheel_expire(long n) {
+	long i, fired;
+	unsigned long seed;
+	struct wtimer *timers, *expired, *t, *tmp;
+	struct wheel w;
+
+	timers = (struct wtimer*) bench_calloc(n, sizeof(*t));
+	wheel_init(&w, 0);
+	expired = NULL;
+	seed = 12345;
+	fired = 0;
+
+	bench_start();
+	for(i = 0; i < n; i++) wheel_schedule(&w, &timers[i], timer_random(&seed, n));
+	for(i = 0; i < n; i++) {
+		wheel_advance(&w, i, &expired);
+		list_foreach_safe(&expired, t, tmp) {
+			list_remove(&expired, t);
+			fired++;
+		}
+	}
+	bench_stop(n);
+
+	bench_sink = fired;
+	wheel_free(&w);
+	bench_free(timers);
+}
+
+static void heap_expire(long n) {
+	long i, fired;
+	unsigned long seed;
+	struct wtimer *timers;
+	struct htimer *h, e;
+
+	timers = (struct wtimer*) bench_calloc(n, sizeof(*timers));
+	array_new(&h, struct htimer);
+	seed = 12345;
+	fired = 0;
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		e.expires = timers[i].expires = timer_random(&seed, n);
+		e.timer = &timers[i];
+		e.gen = 0;
+		timer_heap_push(&h, e);
+	}
+	for(i = 0; i < n; i++) {
+		while(array_len(h) && h[0].expires <= (uint64_t) i) {
+			timer_heap_pop(&h);
+			fired++;
+		}
+	}
+	bench_stop(n);
+
+	bench_sink = fired;
+	array_free(h);
+	bench_free(timers);
+}
+
+static void wheel_reset(long n) {
+	long i;
+	unsigned long seed;
+	struct wtimer *timers, *expired, *t, *tmp;
+	struct wheel w;
+
+	timers = (struct wtimer*) bench_calloc(n, sizeof(*t));
+	wheel_init(&w, 0);
+	expired = NULL;
+	seed = 12345;
+	for(i = 0; i < n; i++) wheel_schedule(&w, &timers[i], timer_random(&seed, n));
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		t = &timers[timer_random(&seed, n)];
+		wheel_cancel(&w, t);
+		wheel_schedule(&w, t, i + timer_random(&seed, n));
+		wheel_advance(&w, i, &expired);
+		list_foreach_safe(&expired, t, tmp) {
+			list_remove(&expired, t);
+			wheel_schedule(&w, t, i + 1 + timer_random(&seed, n));
+		}
+	}
+	bench_stop(n);
+
+	wheel_free(&w);
+	bench_free(timers);
+}
+
+static void heap_reset(long n) {
+	long i;
+	unsigned long seed;
+	struct wtimer *timers, *t;
+	struct htimer *h, e;
+
+	timers = (struct wtimer*) bench_calloc(n, sizeof(*timers));
+	array_new(&h, struct htimer);
+	seed = 12345;
+	for(i = 0; i < n; i++) {
+		e.expires = timers[i].expires = timer_random(&seed, n);
+		e.timer = &timers[i];
+		e.gen = 0;
+		timer_heap_push(&h, e);
+	}
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		t = &timers[timer_random(&seed, n)];
+		e.expires = t->expires = i + timer_random(&seed, n);
+		e.timer = t;
+		e.gen = ++t->gen;
+		timer_heap_push(&h, e);
+		while(array_len(h) && h[0].expires <= (uint64_t) i) {
+			e = timer_heap_pop(&h);
+			if(e.gen != e.timer->gen) continue;
+			e.expires = e.timer->expires = i + 1 + timer_random(&seed, n);
+			e.gen = ++e.timer->gen;
+			timer_heap_push(&h, e);
+		}
+	}
+	bench_stop(n);
+
+	array_free(h);
+	bench_free(timers);
+}
+
+/* Loading saved arrays
+ *
+ * Loading an array of n longs from a file and summing it up, once by mapping
+ * a file written by array_save and once by reading the raw elements into a new
+ * array. The file is in the page cache for both.
+ */
+#define LOAD_PATH "/tmp/list_h_bench.bin"
+
+static void dyn_array_load_map(long n) {
+	long i, sum, *values;
+
+	array_new(&values, long);
+	for(i = 0; i < n; i++) array_append(values, i);
+	array_save(values, LOAD_PATH);
+	array_free(values);
+	sum = 0;
+
+	bench_start();
+	if(array_map(&values, long, LOAD_PATH, ARRAY_MAP_READ_ONLY) < 0) return;
+	for(i = 0; i < (long) array_len(values); i++) sum += values[i];
+	bench_stop(n);
+
+	bench_sink = sum;
+	array_free(values);
+	unlink(LOAD_PATH);
+}
+
+static void dyn_array_load_read(long n) {
+	long i, sum, *values;
+	int fd;
+
+	array_new(&values, long);
+	for(i = 0; i < n; i++) array_append(values, i);
+	fd = open(LOAD_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(write(fd, values, n * sizeof(long)) < 0) return;
+	close(fd);
+	array_free(values);
+	sum = 0;
+
+	bench_start();
+	fd = open(LOAD_PATH, O_RDONLY);
+	array_new(&values, long);
+	array_reserve(values, n);
+	for(i = 0; i < n; i += read(fd, values + i, (n - i) * sizeof(long)) / 8);
+	array_meta(values)->count = n;
+	close(fd);
+	for(i = 0; i < (long) array_len(values); i++) sum += values[i];
+	bench_stop(n);
+
+	bench_sink = sum;
+	array_free(values);
+	unlink(LOAD_PATH);
+}
+
+/* Parallel iteration
+ *
+ * Every node or element gets a few hundred nanoseconds of arithmetic, the
+ * scaling from one thread to all cores shows how much of that is spread over
+ * the cores.
+ */
+static long parallel_value(long v) {
+	int i;
+
+	for(i = 0; i < 100; i++) v = v * 6364136223846793005L + 1442695040888963407L;
+
+	return v;
+}
+
+static void parallel_visit(void *item, void *ctx) {
+	struct element *node;
+
+	(void) ctx;
+	node = (struct element*) item;
+	node->value = parallel_value(node->value);
+}
+
+static void parallel_visit_long(void *item, void *ctx) {
+	(void) ctx;
+	*(long*) item = parallel_value(*(long*) item);
+}
+
+static void list_h_parallel(long n, int nthreads) {
+	struct element *list;
+
+	list = build_scattered_list(n);
+
+	bench_start();
+	list_parallel_foreach(&list, parallel_visit, NULL, nthreads);
+	bench_stop(n);
+
+	bench_sink = list->value;
+	free_list(&list);
+}
+
+static void list_h_parallel_serial(long n) {
+	struct element *list, *node;
+
+	list = build_scattered_list(n);
+
+	bench_start();
+	list_foreach(&list, node) node->value = parallel_value(node->value);
+	bench_stop(n);
+
+	bench_sink = list->value;
+	free_list(&list);
+}
+
+static void list_h_parallel_1(long n) {
+	list_h_parallel(n, 1);
+}
+
+static void list_h_parallel_2(long n) {
+	list_h_parallel(n, 2);
+}
+
+static void list_h_parallel_4(long n) {
+	list_h_parallel(n, 4);
+}
+
+static void list_h_parallel_8(long n) {
+	list_h_parallel(n, 8);
+}
+
+static void list_h_parallel_all(long n) {
+	list_h_parallel(n, 0);
+}
+
+static void dyn_array_parallel(long n, int nthreads) {
+	long i, *vals;
+
+	array_new(&vals, long);
+	for(i = 0; i < n; i++) array_append(vals, i);
+
+	bench_start();
+	array_parallel_foreach(vals, parallel_visit_long, NULL, nthreads);
+	bench_stop(n);
+
+	bench_sink = vals[n - 1];
+	array_free(vals);
+}
+
+static void dyn_array_parallel_1(long n) {
+	dyn_array_parallel(n, 1);
+}
+
+static void dyn_array_parallel_2(long n) {
+	dyn_array_parallel(n, 2);
+}
+
+static void dyn_array_parallel_4(long n) {
+	dyn_array_parallel(n, 4);
+}
+
+static void dyn_array_parallel_8(long n) {
+	dyn_array_parallel(n, 8);
+}
+
+static void dyn_array_parallel_all(long n) {
+	dyn_array_parallel(n, 0);
+}
+
+/* Array kernels
+ *
+ * Every case goes through all n ints of an array once. The scalar cases call
+ * the plain loops of list.h directly, which the compiler is free to vectorize
+ * on its own.
+ */
+static int *build_ints(long n) {
+	long i;
+	int *vals, v;
+
+	array_new(&vals, int);
+	for(i = 0; i < n; i++) {
+		v = (int) (i % 1000);
+		array_append(vals, v);
+	}
+
+	return vals;
+}
+
+static void dyn_array_find(long n) {
+	int *vals;
+
+	vals = build_ints(n);
+
+	bench_start();
+	bench_sink = (long) array_find(vals, -1);
+	bench_stop(n);
+
+	array_free(vals);
+}
+
+static void dyn_array_find_scalar(long n) {
+	int *vals;
+
+	vals = build_ints(n);
+
+	bench_start();
+	bench_sink = (long) array_find_scalar_(vals, array_len(vals), sizeof(int),
+			array_kind_(vals), array_bits_(vals, -1), 0);
+	bench_stop(n);
+
+	array_free(vals);
+}
+
+static void vector_find(long n) {
+	int *vals;
+	std::vector<int> c;
+
+	vals = build_ints(n);
+	c.assign(vals, vals + n);
+	array_free(vals);
+
+	bench_start();
+	bench_sink = std::find(c.begin(), c.end(), -1) - c.begin();
+	bench_stop(n);
+}
+
+static void dyn_array_count(long n) {
+	int *vals;
+
+	vals = build_ints(n);
+
+	bench_start();
+	bench_sink = (long) array_count(vals, 7);
+	bench_stop(n);
+
+	array_free(vals);
+}
+
+static void dyn_array_count_scalar(long n) {
+	int *vals;
+
+	vals = build_ints(n);
+
+	bench_start();
+	bench_sink = (long) array_count_scalar_(vals, array_len(vals),
+			sizeof(int), array_kind_(vals), array_bits_(vals, 7), 0);
+	bench_stop(n);
+
+	array_free(vals);
+}
+
+static void vector_count(long n) {
+	int *vals;
+	std::vector<int> c;
+
+	vals = build_ints(n);
+	c.assign(vals, vals + n);
+	array_free(vals);
+
+	bench_start();
+	bench_sink = std::count(c.begin(), c.end(), 7);
+	bench_stop(n);
+}
+
+static void dyn_array_fill(long n) {
+	int *vals;
+
+	vals = build_ints(n);
+
+	bench_start();
+	array_fill(vals, 7);
+	bench_stop(n);
+
+	bench_sink = vals[n - 1];
+	array_free(vals);
+}
+
+static void dyn_array_fill_scalar(long n) {
+	int *vals;
+
+	vals = build_ints(n);
+
+	bench_start();
+	array_fill_scalar_(vals, array_len(vals), sizeof(int), array_kind_(vals),
+			array_bits_(vals, 7), 0);
+	bench_stop(n);
+
+	bench_sink = vals[n - 1];
+	array_free(vals);
+}
+
+static void vector_fill(long n) {
+	int *vals;
+	std::vector<int> c;
+
+	vals = build_ints(n);
+	c.assign(vals, vals + n);
+	array_free(vals);
+
+	bench_start();
+	std::fill(c.begin(), c.end(), 7);
+	bench_stop(n);
+
+	bench_sink = c[n - 1];
+}
+
+static void dyn_array_sum(long n) {
+	long sum;
+	int *vals;
+
+	vals = build_ints(n);
+
+	bench_start();
+	array_sum(vals, &sum);
+	bench_stop(n);
+
+	bench_sink = sum;
+	array_free(vals);
+}
+
+static void dyn_array_sum_scalar(long n) {
+	uint64_t sum;
+	int *vals;
+
+	vals = build_ints(n);
+
+	bench_start();
+	array_sum_scalar_(vals, array_len(vals), sizeof(int), array_kind_(vals),
+			&sum);
+	bench_stop(n);
+
+	bench_sink = (long) sum;
+	array_free(vals);
+}
+
+static void vector_sum(long n) {
+	int *vals;
+	std::vector<int> c;
+
+	vals = build_ints(n);
+	c.assign(vals, vals + n);
+	array_free(vals);
+
+	bench_start();
+	bench_sink = std::accumulate(c.begin(), c.end(), 0L);
+	bench_stop(n);
+}
+
+static void dyn_array_minmax(long n) {
+	int lo, hi, *vals;
+
+	vals = build_ints(n);
+	lo = hi = 0;
+
+	bench_start();
+	array_minmax(vals, &lo, &hi);
+	bench_stop(n);
+
+	bench_sink = lo + hi;
+	array_free(vals);
+}
+
+static void dyn_array_minmax_scalar(long n) {
+	int lo, hi, *vals;
+
+	vals = build_ints(n);
+	lo = hi = 0;
+
+	bench_start();
+	array_minmax_scalar_(vals, array_len(vals), sizeof(int),
+			array_kind_(vals), &lo, &hi);
+	bench_stop(n);
+
+	bench_sink = lo + hi;
+	array_free(vals);
+}
+
+static void vector_minmax(long n) {
+	int *vals;
+	std::vector<int> c;
+
+	vals = build_ints(n);
+	c.assign(vals, vals + n);
+	array_free(vals);
+
+	bench_start();
+	auto r = std::minmax_element(c.begin(), c.end());
+	bench_stop(n);
+
+	bench_sink = *r.first + *r.second;
+}
+
+/* FIFO queues
+ *
+ * A queue of 1000 elements, every operation adds one element at the back and
+ * takes one from the front.
+ */
+#define FIFO_WINDOW 1000
+
+static void list_h_fifo(long n) {
+	long i, sum;
+	struct element *list, *node;
+
+	list = build_list(FIFO_WINDOW);
+	sum = 0;
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		node = (struct element*) bench_calloc(1, sizeof(struct element));
+		node->value = i;
+		list_append(&list, node);
+		node = list;
+		list_remove(&list, node);
+		sum += node->value;
+		bench_free(node);
+	}
+	bench_stop(n);
+
+	bench_sink = sum;
+	free_list(&list);
+}
+
+static void ring_fifo(long n) {
+	long i, sum, *ring;
+
+	ring_new(&ring, long, FIFO_WINDOW);
+	for(i = 0; i < FIFO_WINDOW; i++) ring_push_back(ring, i);
+	sum = 0;
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		ring_push_back(ring, i);
+		sum += ring_pop_front(ring);
+	}
+	bench_stop(n);
+
+	bench_sink = sum;
+	ring_free(ring);
+}
+
+static void deque_fifo(long n) {
+	long i, sum;
+	std::deque<long> c;
+
+	for(i = 0; i < FIFO_WINDOW; i++) c.push_back(i);
+	sum = 0;
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		c.push_back(i);
+		sum += c.front();
+		c.pop_front();
+	}
+	bench_stop(n);
+
+	bench_sink = sum;
+}
+
+/* Growing large arrays
+ *
+ * Records are 128 bytes, so /bench -n 100000000 -o array_grow/ grows arrays to
+ * 1.28 GB and 12.8 GB. The peak RSS shows whether growing had to copy.
+ */
+struct record {
+	long value;
+	char data[120];
+};
+
+static void dyn_array_grow_mode(long n, int mode) {
+	long i;
+	struct record r, *vals;
+
+	memset(&r, 0, sizeof(r));
+	array_new_mode(&vals, struct record, mode);
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		r.value = i;
+		array_append(vals, r);
+	}
+	bench_stop(n);
+
+	bench_sink = vals[n - 1].value;
+	array_free(vals);
+}
+
+static void dyn_array_grow(long n) {
+	dyn_array_grow_mode(n, ARRAY_MODE_HEAP);
+}
+
+static void dyn_array_grow_mmap(long n) {
+	dyn_array_grow_mode(n, ARRAY_MODE_MMAP);
+}
+
+static void dyn_array_grow_huge(long n) {
+	dyn_array_grow_mode(n, ARRAY_MODE_HUGE);
+}
+
+static void vector_grow(long n) {
+	long i;
+	struct record r;
+	std::vector<struct record> c;
+
+	memset(&r, 0, sizeof(r));
+
+	bench_start();
+	for(i = 0; i < n; i++) {
+		r.value = i;
+		c.push_back(r);
+	}
+	bench_stop(n);
+
+	bench_sink = c[n - 1].value;
+}
+
+/* STL containers
+ *
+ * The same operations written once for every container that supports them.
+ */
+
+template<class C> static void stl_append(long n) {
+	long i;
+	C *c;
+
+	c = new C();
+
+	bench_start();
+	for(i = 0; i < n; i++) c->push_back(i);
+	bench_stop(n);
+
+	delete c;
+}
+
+template<class C> static void stl_prepend(long n) {
+	long i;
+	C *c;
+
+	c = new C();
+
+	bench_start();
+	for(i = 0; i < n; i++) c->push_front(i);
+	bench_stop(n);
+
+	delete c;
+}
+
+template<class C> static void stl_insert_after(long n) {
+	long i;
+	C c;
+	typename C::iterator it;
+
+	c.push_back(0);
+	it = c.begin();
+
+	bench_start();
+	for(i = 1; i < n; i++) {
+		it = c.insert(std::next(it), i);
+		if(++it == c.end()) it = c.begin();
+	}
+	bench_stop(n - 1);
+}
+
+template<class C> static void stl_remove(long n) {
+	long i;
+	C c(n);
+
+	bench_start();
+	for(i = 0; i < n; i++) c.pop_front();
+	bench_stop(n);
+}
+
+template<class C> static void stl_teardown(long n) {
+	C *c;
+
+	c = new C(n);
+
+	bench_start();
+	delete c;
+	bench_stop(n);
+}
+
+template<class C> static void stl_iterate(long n) {
+	long i, sum;
+	C c;
+
+	for(i = 0; i < n; i++) c.push_back(i);
+
+	bench_start();
+	sum = 0;
+	for(typename C::iterator it = c.begin(); it != c.end(); ++it) sum += *it;
+	bench_stop(n);
+
+	bench_sink = sum;
+}
+
+template<class C> static void stl_iterate_reverse(long n) {
+	long i, sum;
+	C c;
+
+	for(i = 0; i < n; i++) c.push_back(i);
+
+	bench_start();
+	sum = 0;
+	for(typename C::reverse_iterator it = c.rbegin(); it != c.rend(); ++it)
+		sum += *it;
+	bench_stop(n);
+
+	bench_sink = sum;
+}
+
+template<class C> static void stl_sort(long n) {
+	long i;
+	C c;
+
+	for(i = 0; i < n; i++) c.push_back(random_value(i));
+
+	bench_start();
+	std::sort(c.begin(), c.end());
+	bench_stop(n);
+}
+
+static void std_list_sort(long n) {
+	long i;
+	std::list<long> c;
+
+	for(i = 0; i < n; i++) c.push_back(random_value(i));
+
+	bench_start();
+	c.sort();
+	bench_stop(n);
+}
+
+static void std_list_merge(long n) {
+	long i;
+	std::list<long> a, b;
+
+	for(i = 0; i < n / 2; i++) a.push_back(2 * i);
+	for(i = 0; i < n - n / 2; i++) b.push_back(2 * i + 1);
+
+	bench_start();
+	a.merge(b);
+	bench_stop(n);
+}
+
+static void std_list_splice(long n) {
+	std::list<long> a(1), b(n);
+
+	bench_start();
+	a.splice(a.end(), b);
+	bench_stop(n);
+}
+
+static void std_list_split(long n) {
+	std::list<long> a(n), b;
+	std::list<long>::iterator at;
+
+	at = std::next(a.begin(), n / 2);
+
+	bench_start();
+	b.splice(b.end(), a, at, a.end());
+	bench_stop(n - n / 2);
+}
+
+static void vector_reserve(long n) {
+	long i;
+	std::vector<long> c;
+
+	bench_start();
+	c.reserve(n);
+	for(i = 0; i < n; i++) c.push_back(i);
+	bench_stop(n);
+}
+
+typedef std::list<long> stl_list;
+typedef std::deque<long> stl_deque;
+typedef std::vector<long> stl_vector;
+
+static struct bench benches[] = {
+	{"append", "list.h", list_h_append},
+	{"append", "list.h typed", typed_append},
+	{"append", "list.h pool", pool_append},
+	{"append", "unrolled list", unrolled_append_bench},
+	{"append", "index list", ilist_append_bench},
+	{"append", "std::list", stl_append<stl_list>},
+	{"append", "std::deque", stl_append<stl_deque>},
+	{"append", "std::vector", stl_append<stl_vector>},
+	{"append", "list.hpp", hpp_append},
+	{"prepend", "list.h", list_h_prepend},
+	{"prepend", "std::list", stl_prepend<stl_list>},
+	{"prepend", "std::deque", stl_prepend<stl_deque>},
+	{"insert_after", "list.h", list_h_insert_after},
+	{"insert_after", "unrolled list", unrolled_insert_bench},
+	{"insert_after", "std::list", stl_insert_after<stl_list>},
+	{"remove", "list.h", list_h_remove},
+	{"remove", "std::list", stl_remove<stl_list>},
+	{"remove", "std::deque", stl_remove<stl_deque>},
+	{"teardown", "list.h", list_h_teardown},
+	{"teardown", "list.h pool", pool_teardown},
+	{"teardown", "std::list", stl_teardown<stl_list>},
+	{"teardown", "std::deque", stl_teardown<stl_deque>},
+	{"iterate", "list.h", list_h_iterate},
+	{"iterate", "list.h typed", typed_iterate},
+	{"iterate", "list.h pool", pool_iterate},
+	{"iterate", "unrolled list", unrolled_iterate},
+	{"iterate", "index list", ilist_iterate},
+	{"iterate", "std::list", stl_iterate<stl_list>},
+	{"iterate", "std::deque", stl_iterate<stl_deque>},
+	{"iterate", "std::vector", stl_iterate<stl_vector>},
+	{"iterate", "dyn_array", dyn_array_iterate},
+	{"iterate", "list.hpp", hpp_iterate},
+	{"iterate", "list.hpp dyn_array", stl_iterate<hpp_array>},
+	{"iterate_reverse", "list.h", list_h_iterate_reverse},
+	{"iterate_reverse", "list.h typed", typed_iterate_reverse},
+	{"iterate_reverse", "unrolled list", unrolled_iterate_reverse},
+	{"iterate_reverse", "index list", ilist_iterate_reverse},
+	{"iterate_reverse", "std::list", stl_iterate_reverse<stl_list>},
+	{"iterate_reverse", "std::deque", stl_iterate_reverse<stl_deque>},
+	{"iterate_reverse", "std::vector", stl_iterate_reverse<stl_vector>},
+	{"iterate_reverse", "dyn_array", dyn_array_iterate_reverse},
+	{"iterate_reverse", "list.hpp", hpp_iterate_reverse},
+	{"iterate_reverse", "list.hpp dyn_array", stl_iterate_reverse<hpp_array>},
+	{"iterate_scattered", "list.h", scattered_iterate},
+	{"iterate_scattered", "list.h prefetch", scattered_iterate_prefetch},
+	{"iterate_scattered", "list.h compacted", scattered_iterate_compacted},
+	{"compact", "list.h", scattered_compact},
+	{"iterate_scattered_reverse", "list.h", scattered_iterate_reverse},
+	{"iterate_scattered_reverse", "list.h prefetch",
+		scattered_iterate_prefetch_reverse},
+	{"sort", "list.h", list_h_sort},
+	{"sort", "std::list", std_list_sort},
+	{"sort", "std::vector", stl_sort<stl_vector>},
+	{"sort", "list.hpp dyn_array", stl_sort<hpp_array>},
+	{"merge_sorted", "list.h", list_h_merge_sorted},
+	{"merge_sorted", "std::list", std_list_merge},
+	{"concat", "list.h", list_h_concat},
+	{"concat", "list.h per node", list_h_concat_per_node},
+	{"concat", "std::list", std_list_splice},
+	{"split", "list.h", list_h_split},
+	{"split", "std::list", std_list_split},
+	{"queue", "list_mpsc", queue_mpsc},
+	{"queue", "list.h with mutex", queue_mutex},
+	{"array_append", "dyn_array", dyn_array_append},
+	{"array_append", "dyn_array typed", typed_array_append},
+	{"array_append", "dyn_array 1.5x", dyn_array_append_half},
+	{"array_append", "std::vector", stl_append<stl_vector>},
+	{"array_append", "list.hpp dyn_array", stl_append<hpp_array>},
+	{"array_reserve", "dyn_array", dyn_array_reserve},
+	{"array_reserve", "std::vector", vector_reserve},
+	{"array_grow", "dyn_array", dyn_array_grow},
+	{"array_grow", "dyn_array mmap", dyn_array_grow_mmap},
+	{"array_grow", "dyn_array mmap huge", dyn_array_grow_huge},
+	{"array_grow", "std::vector", vector_grow},
+	{"fifo", "list.h", list_h_fifo},
+	{"fifo", "ring", ring_fifo},
+	{"fifo", "std::deque", deque_fifo},
+	{"sorted_insert", "list.h scan", list_h_sorted_insert},
+	{"sorted_insert", "skiplist", skiplist_sorted_insert},
+	{"sorted_insert", "std::multiset", multiset_sorted_insert},
+	{"lower_bound", "list.h scan", list_h_lower_bound},
+	{"lower_bound", "skiplist", skiplist_lower_bound},
+	{"lower_bound", "std::multiset", multiset_lower_bound},
+	{"heap_push_pop", "heap 2-ary", heap_push_pop<heap2_push, heap2_pop>},
+	{"heap_push_pop", "heap 4-ary", heap_push_pop<heap4_push, heap4_pop>},
+	{"heap_push_pop", "std::priority_queue", priority_queue_push_pop},
+	{"heapify", "heap 2-ary", heap_heapify<heap2_heapify>},
+	{"heapify", "heap 4-ary", heap_heapify<heap4_heapify>},
+	{"heapify", "std::make_heap", vector_make_heap},
+	{"lru_zipf", "lru_cache", lru_cache_zipf},
+	{"lru_zipf", "list.h + std::unordered_map", list_h_unordered_map_zipf},
+	{"lru_zipf", "std::list + std::unordered_map", std_list_unordered_map_zipf},
+	{"timer_expire", "timer wheel", wheel_expire},
+	{"timer_expire", "heap", heap_expire},
+	{"timer_reset", "timer wheel", wheel_reset},
+	{"timer_reset", "heap", heap_reset},
+	{"array_load", "array_map", dyn_array_load_map},
+	{"array_load", "read", dyn_array_load_read},
+	{"parallel_foreach", "list.h serial", list_h_parallel_serial},
+	{"parallel_foreach", "list.h 1 thread", list_h_parallel_1},
+	{"parallel_foreach", "list.h 2 threads", list_h_parallel_2},
+	{"parallel_foreach", "list.h 4 threads", list_h_parallel_4},
+	{"parallel_foreach", "list.h 8 threads", list_h_parallel_8},
+	{"parallel_foreach", "list.h all cores", list_h_parallel_all},
+	{"parallel_foreach", "dyn_array 1 thread", dyn_array_parallel_1},
+	{"parallel_foreach", "dyn_array 2 threads", dyn_array_parallel_2},
+	{"parallel_foreach", "dyn_array 4 threads", dyn_array_parallel_4},
+	{"parallel_foreach", "dyn_array 8 threads", dyn_array_parallel_8},
+	{"parallel_foreach", "dyn_array all cores", dyn_array_parallel_all},
+	{"array_find", "dyn_array", dyn_array_find},
+	{"array_find", "dyn_array scalar", dyn_array_find_scalar},
+	{"array_find", "std::vector", vector_find},
+	{"array_count", "dyn_array", dyn_array_count},
+	{"array_count", "dyn_array scalar", dyn_array_count_scalar},
+	{"array_count", "std::vector", vector_count},
+	{"array_fill", "dyn_array", dyn_array_fill},
+	{"array_fill", "dyn_array scalar", dyn_array_fill_scalar},
+	{"array_fill", "std::vector", vector_fill},
+	{"array_sum", "dyn_array", dyn_array_sum},
+	{"array_sum", "dyn_array scalar", dyn_array_sum_scalar},
+	{"array_sum", "std::vector", vector_sum},
+	{"array_minmax", "dyn_array", dyn_array_minmax},
+	{"array_minmax", "dyn_array scalar", dyn_array_minmax_scalar},
+	{"array_minmax", "std::vector", vector_minmax},
+};
+
+static int json;
+static int first_row = 1;
+
+static void print_header() {
+	if(json) printf("[\n");
+	else {
+		printf("operation,container,n,ns_per_op,peak_rss_kb,allocs,frees,"
+				"runs\n");
+	}
+}
+
+static void print_footer() {
+	if(json) printf("%s]\n", first_row ? "" : "\n");
+}
+
+static void print_row(struct bench *b, long n, long rss, long runs) {
+	double ns;
+
+	ns = bench_elapsed * 1e9 / bench_ops;
+
+	if(json) {
+		printf("%s  {\"operation\": \"%s\", \"container\": \"%s\", "
+				"\"n\": %ld, \"ns_per_op\": %.3f, "
+				"\"peak_rss_kb\": %ld, \"allocs\": %ld, "
+				"\"frees\": %ld, \"runs\": %ld}", first_row ? "" : ",\n",
+				b->operation, b->container, n, ns, rss,
+				bench_nallocs, bench_nfrees, runs);
+	}
+	else {
+		printf("%s,%s,%ld,%.3f,%ld,%ld,%ld,%ld\n", b->operation,
+				b->container, n, ns, rss, bench_nallocs, bench_nfrees, runs);
+	}
+}
+
+/* Runs case B until it took the minimum time, returns the amount of runs
+ *
+ * The results of the fastest run end up in bench_elapsed and the other
+ * results of the measured part. Returns 0 if the case doesn't measure
+ * anything for N elements.
+ */
+static long run_repeated(struct bench *b, long n) {
+	double best, t0;
+	long runs, nallocs, nfrees;
+
+	best = 0;
+	nallocs = nfrees = 0;
+	t0 = now();
+	for(runs = 0; runs < BENCH_MAX_RUNS; runs++) {
+		if(runs >= BENCH_MIN_RUNS && now() - t0 >= bench_min_time) break;
+
+		bench_measured = 0;
+		b->func(n);
+		if(!bench_measured) return 0;
+
+		if(runs == 0 || bench_elapsed < best) {
+			best = bench_elapsed;
+			nallocs = bench_nallocs;
+			nfrees = bench_nfrees;
+		}
+	}
+
+	bench_elapsed = best;
+	bench_nallocs = nallocs;
+	bench_nfrees = nfrees;
+
+	return runs;
+}
+
+/* Runs a single case in a child process
+ *
+ * Returns 1 if the case printed a result.
+ */
+static int run_case(struct bench *b, long n) {
+	int status;
+	long runs;
+	pid_t pid;
+	struct rusage usage;
+
+	fflush(stdout);
+
+	pid = fork();
+	if(pid < 0) {
+		perror("fork");
+		exit(1);
+	}
+
+	if(pid == 0) {
+		runs = run_repeated(b, n);
+
+		if(runs) {
+			getrusage(RUSAGE_SELF, &usage);
+			print_row(b, n, usage.ru_maxrss, runs);
+		}
+
+		fflush(stdout);
+		_exit(runs ? 0 : 2);
+	}
+
+	waitpid(pid, &status, 0);
+
+	if(WIFEXITED(status) && WEXITSTATUS(status) == 0) return 1;
+	if(!WIFEXITED(status) || WEXITSTATUS(status) != 2) {
+		fprintf(stderr, "%s/%s with n=%ld failed\n", b->operation,
+				b->container, n);
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	int i, opt, num_benches;
+	long n, max;
+	const char *filter;
+
+	max = 1000000;
+	filter = NULL;
+
+	while((opt = getopt(argc, argv, "f:n:o:t:")) != -1) {
+		switch(opt) {
+			case 'f': json = strcmp(optarg, "json") == 0; break;
+			case 'n': max = atol(optarg); break;
+			case 'o': filter = optarg; break;
+			case 't': bench_min_time = atof(optarg); break;
+			default:
+				fprintf(stderr, "usage: %s [-f csv|json] [-n MAX] "
+						"[-o FILTER] [-t SECONDS]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	num_benches = sizeof(benches) / sizeof(struct bench);
+
+	print_header();
+	for(i = 0; i < num_benches; i++) {
+		if(filter && !strstr(benches[i].operation, filter)) continue;
+
+		for(n = 10; n <= max; n *= 10) {
+			if(run_case(&benches[i], n)) first_row = 0;
+		}
+	}
+	print_footer();
+
+	return 0;
+}
@@ -1,6 +1,5 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 #include "list.h"
 
 struct node {
@@ -43,8 +42,33 @@ void example_list() {
 	}
 }
 
+void example_pool() {
+	int i;
+	struct list_pool *pool;
+	struct node *list, *node;
+
+	// Pools hand out nodes from big chunks instead of calling calloc for
+	// every single node
+	pool = list_pool_new(struct node, 64);
+	list = NULL;
+
+	for(i = 0; i < 16; i++) {
+		node = list_pool_alloc(pool);
+		node->value = i + 1;
+
+		list_append(&list, node);
+	}
+
+	list_foreach(&list, node) {
+		printf("%d\n", node->value);
+	}
+
+	// Free the list and all of its nodes in one go
+	list_pool_free_list(&list, pool);
+}
+
 void example_array() {
-	int i, n;
+	size_t i, n;
 	int *vals;
 	int othervals[] = {17, 18, 19, 20, 21, 22, 23, 24};
 
@@ -58,10 +82,8 @@ void example_array() {
 		array_append(vals, i + 1);
 	}
 
-	// manually expand array and copy values
-	array_reserve(vals, array_len(vals) + n);
-	memcpy(vals + array_len(vals), othervals, sizeof(int) * n);
-	array_len(vals) += n;
+	// copy all the other values at once
+	array_extend(vals, othervals, n);
 
 	// print the values
 	for(i = 0; i < array_len(vals); i++) {
@@ -76,6 +98,9 @@ int main() {
 	printf("List example:\n");
 	example_list();
 
+	printf("\n\nPool example:\n");
+	example_pool();
+
 	printf("\n\nArray example:\n");
 	example_array();
 
@@ -74,12 +74,329 @@ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
 PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <unistd.h>
+#define LIST_HAS_THREADS_ 1
+#else
+#define LIST_HAS_THREADS_ 0
+#endif
+
+/* Null pointers and pointer conversions
+ *
+ * C++ does not convert void pointers implicitly, so these macros are used
+ * wherever a void pointer ends up in a typed pointer. This keeps the header
+ * usable from C++ code as well.
+ */
+#ifdef __cplusplus
+#define list_null_ nullptr
+#define list_cast_(X, P) ((__typeof__(X)) (P))
+#else
+#define list_null_ ((void*) 0)
+#define list_cast_(X, P) (P)
+#endif
+
+/* Allocation
+ *
+ * Every allocation of this file goes through these macros, which default to
+ * the C allocator. Define them before including this file to route lists,
+ * pools and arrays to jemalloc or mimalloc, an arena or a tracking allocator:
+ * 	LIST_MALLOC(SIZE)
+ * 	LIST_CALLOC(N, SIZE)
+ * 	LIST_REALLOC(P, SIZE)
+ * 	LIST_FREE(P)
+ *
+ * When LIST_MALLOC is defined but LIST_CALLOC is not, LIST_CALLOC clears the
+ * memory of LIST_MALLOC. Arrays in a memory mapping (see array_set_mode and
+ * array_map) come from mmap instead. Single arrays can also have an allocator
+ * of their own, see array_new_allocator.
+ *
+ * Example:
+ * #define LIST_MALLOC(S) mi_malloc(S)
+ * #define LIST_REALLOC(P, S) mi_realloc(P, S)
+ * #define LIST_FREE(P) mi_free(P)
+ * #include "list.h"
+ */
+#ifndef LIST_CALLOC
+#ifdef LIST_MALLOC
+#define LIST_CALLOC(N, S) list_calloc_((N), (S))
+#else
+#define LIST_CALLOC(N, S) calloc((N), (S))
+#endif
+#endif
+
+#ifndef LIST_MALLOC
+#define LIST_MALLOC(S) malloc(S)
+#endif
+
+#ifndef LIST_REALLOC
+#define LIST_REALLOC(P, S) realloc((P), (S))
+#endif
+
+#ifndef LIST_FREE
+#define LIST_FREE(P) free(P)
+#endif
+
+/* calloc on top of LIST_MALLOC */
+static inline void *list_calloc_(size_t n, size_t size) {
+	void *p;
+
+	if(size && n > SIZE_MAX / size) return list_null_;
+	p = LIST_MALLOC(n * size);
+	if(p) memset(p, 0, n * size);
+
+	return p;
+}
+
+/* Statistics
+ *
+ * When LIST_STATS is defined before including this file, the macros count
+ * what they do, so the list and array work of a program can be looked at
+ * without a profiler. Without LIST_STATS none of this exists and the macros
+ * compile to the same code as if there was no counting at all.
+ *
+ * Every thread counts into its own block of counters, so counting doesn't add
+ * any contention between threads. list_stats_read adds up the blocks of all
+ * threads, including the ones that have exited already:
+ * 	void list_stats_read(struct list_stats *stats)
+ * 	void list_stats_reset(void)
+ * 	void list_stats_dump(FILE *f)
+ *
+ * The counters of other threads are read while they may still be counting,
+ * so the totals are only exact once those threads are idle. Statistics need
+ * GCC or Clang and POSIX threads.
+ *
+ * Example:
+ * #define LIST_STATS
+ * #include "list.h"
+ * ...
+ * list_stats_dump(stderr);
+ */
+#ifdef LIST_STATS
+#if !LIST_HAS_THREADS_ || !(defined(__GNUC__) || defined(__clang__))
+#error "LIST_STATS needs GCC or Clang and POSIX threads"
+#endif
+
+#include <stdio.h>
+
+struct list_stats {
+	uint64_t appends; // list_append
+	uint64_t prepends; // list_prepend
+	uint64_t inserts; // list_insert_after and list_insert_before
+	uint64_t removes; // list_remove
+	uint64_t splices; // list_concat, list_splice_after and list_split
+	uint64_t steps; // nodes visited by the list_foreach macros
+	uint64_t reallocs; // times a dynamic array was resized
+	uint64_t bytes_moved; // bytes copied when resizing or by array_insert_n
+	uint64_t allocated; // bytes held by dynamic arrays right now
+	uint64_t peak_allocated; // largest value of allocated so far
+};
+
+/* Counters of one thread, linked into the list of all threads */
+struct list_stats_thread_ {
+	struct list_stats_thread_ *next;
+	struct list_stats_thread_ *prev;
+	struct list_stats stats;
+};
+
+/* The state shared by all threads
+ *
+ * The definitions are weak, so every file including this one shares the
+ * same counters.
+ */
+struct list_stats_shared_ {
+	pthread_mutex_t lock;
+	pthread_once_t once;
+	pthread_key_t key;
+	struct list_stats_thread_ *threads;
+	int64_t allocated;
+	uint64_t peak_allocated;
+};
+
+__attribute__((weak)) struct list_stats_shared_ list_stats_shared_ =
+		{PTHREAD_MUTEX_INITIALIZER, PTHREAD_ONCE_INIT, 0, list_null_, 0, 0};
+// sum of the counters of the threads that have exited
+__attribute__((weak)) struct list_stats list_stats_exited_;
+__attribute__((weak)) __thread struct list_stats_thread_ *list_stats_self_;
+// counters of threads that couldn't allocate their own, never read
+__attribute__((weak)) struct list_stats list_stats_dropped_;
+
+/* Adds the counters in B to A, allocated and peak_allocated are global */
+static inline void list_stats_add_(struct list_stats *a,
+		const struct list_stats *b) {
+	a->appends += __atomic_load_n(&b->appends, __ATOMIC_RELAXED);
+	a->prepends += __atomic_load_n(&b->prepends, __ATOMIC_RELAXED);
+	a->inserts += __atomic_load_n(&b->inserts, __ATOMIC_RELAXED);
+	a->removes += __atomic_load_n(&b->removes, __ATOMIC_RELAXED);
+	a->splices += __atomic_load_n(&b->splices, __ATOMIC_RELAXED);
+	a->steps += __atomic_load_n(&b->steps, __ATOMIC_RELAXED);
+	a->reallocs += __atomic_load_n(&b->reallocs, __ATOMIC_RELAXED);
+	a->bytes_moved += __atomic_load_n(&b->bytes_moved, __ATOMIC_RELAXED);
+}
+
+/* Folds the counters of an exiting thread into the shared state */
+static inline void list_stats_exit_(void *p) {
+	struct list_stats_thread_ *self;
+
+	self = (struct list_stats_thread_*) p;
+	pthread_mutex_lock(&list_stats_shared_.lock);
+	list_stats_add_(&list_stats_exited_, &self->stats);
+	// the list macros count themselves, so the links are updated by hand
+	if(list_stats_shared_.threads == self) {
+		list_stats_shared_.threads =
+				self->next == self ? list_null_ : self->next;
+	}
+	self->next->prev = self->prev;
+	self->prev->next = self->next;
+	pthread_mutex_unlock(&list_stats_shared_.lock);
+	list_stats_self_ = list_null_;
+	LIST_FREE(self);
+}
+
+static inline void list_stats_key_(void) {
+	pthread_key_create(&list_stats_shared_.key, list_stats_exit_);
+}
+
+/* Counters of the calling thread, created on first use
+ *
+ * When they can't be allocated the operations of the thread go uncounted,
+ * until a later call manages to allocate them.
+ */
+static inline struct list_stats *list_stats_local_(void) {
+	struct list_stats_thread_ *self, *t;
+
+	if(list_stats_self_) return &list_stats_self_->stats;
+
+	self = (struct list_stats_thread_*) LIST_CALLOC(1, sizeof(*self));
+	if(!self) return &list_stats_dropped_;
+	pthread_once(&list_stats_shared_.once, list_stats_key_);
+	pthread_setspecific(list_stats_shared_.key, self);
+	pthread_mutex_lock(&list_stats_shared_.lock);
+	if((t = list_stats_shared_.threads)) {
+		self->next = t;
+		self->prev = t->prev;
+		t->prev->next = self;
+		t->prev = self;
+	}
+	else {
+		list_stats_shared_.threads = self->next = self->prev = self;
+	}
+	pthread_mutex_unlock(&list_stats_shared_.lock);
+	list_stats_self_ = self;
+
+	return &self->stats;
+}
+
+/* Only the owning thread writes its counters, so there's no need for locked
+ * instructions, relaxed stores just keep readers from seeing torn values.
+ * The dropped counters are shared, which is why the counter is loaded
+ * atomically too, increments may get lost there but nobody reads them.
+ */
+static inline void list_stats_count_(uint64_t *counter, uint64_t n) {
+	__atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n,
+			__ATOMIC_RELAXED);
+}
+
+/* Adds N bytes to the bytes held by arrays, N is negative when freeing */
+static inline void list_stats_bytes_(int64_t n) {
+	uint64_t now, peak;
+
+	now = (uint64_t) (__atomic_add_fetch(&list_stats_shared_.allocated, n,
+			__ATOMIC_RELAXED));
+	peak = __atomic_load_n(&list_stats_shared_.peak_allocated,
+			__ATOMIC_RELAXED);
+	while(n > 0 && now > peak && !__atomic_compare_exchange_n(
+			&list_stats_shared_.peak_allocated, &peak, now, 1,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static inline void list_stats_read(struct list_stats *stats) {
+	struct list_stats_thread_ *t;
+
+	memset(stats, 0, sizeof(*stats));
+	pthread_mutex_lock(&list_stats_shared_.lock);
+	list_stats_add_(stats, &list_stats_exited_);
+	t = list_stats_shared_.threads;
+	while(t) {
+		list_stats_add_(stats, &t->stats);
+		t = t->next == list_stats_shared_.threads ? list_null_ : t->next;
+	}
+	pthread_mutex_unlock(&list_stats_shared_.lock);
+	stats->allocated = (uint64_t) __atomic_load_n(
+			&list_stats_shared_.allocated, __ATOMIC_RELAXED);
+	stats->peak_allocated = __atomic_load_n(
+			&list_stats_shared_.peak_allocated, __ATOMIC_RELAXED);
+}
+
+/* Sets all counters back to zero, the peak to the bytes held right now */
+static inline void list_stats_reset(void) {
+	struct list_stats_thread_ *t;
+
+	pthread_mutex_lock(&list_stats_shared_.lock);
+	memset(&list_stats_exited_, 0, sizeof(struct list_stats));
+	t = list_stats_shared_.threads;
+	while(t) {
+		memset(&t->stats, 0, sizeof(t->stats));
+		t = t->next == list_stats_shared_.threads ? list_null_ : t->next;
+	}
+	pthread_mutex_unlock(&list_stats_shared_.lock);
+	__atomic_store_n(&list_stats_shared_.peak_allocated, (uint64_t)
+			__atomic_load_n(&list_stats_shared_.allocated,
+			__ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+static inline void list_stats_dump(FILE *f) {
+	struct list_stats s;
+
+	list_stats_read(&s);
+	fprintf(f, "appends %llu\n", (unsigned long long) s.appends);
+	fprintf(f, "prepends %llu\n", (unsigned long long) s.prepends);
+	fprintf(f, "inserts %llu\n", (unsigned long long) s.inserts);
+	fprintf(f, "removes %llu\n", (unsigned long long) s.removes);
+	fprintf(f, "splices %llu\n", (unsigned long long) s.splices);
+	fprintf(f, "steps %llu\n", (unsigned long long) s.steps);
+	fprintf(f, "reallocs %llu\n", (unsigned long long) s.reallocs);
+	fprintf(f, "bytes_moved %llu\n", (unsigned long long) s.bytes_moved);
+	fprintf(f, "allocated %llu\n", (unsigned long long) s.allocated);
+	fprintf(f, "peak_allocated %llu\n",
+			(unsigned long long) s.peak_allocated);
+}
+
+/* Count N for the counter FIELD of the calling thread */
+#define list_stat_(FIELD, N) list_stats_count_(&list_stats_local_()->FIELD, \
+		(uint64_t) (N))
+#define list_stat_bytes_(N) list_stats_bytes_((int64_t) (N))
+/* Loop condition of the list_foreach macros, counting the visited nodes */
+#define list_step_(NODE) ((NODE) && (list_stat_(steps, 1), 1))
+#else
+#define list_stat_(FIELD, N) ((void) 0)
+#define list_stat_bytes_(N) ((void) 0)
+#define list_step_(NODE) (NODE)
+#endif
+
 /* Insert a node into the end of a list
  *
  * This operation will make NODE be the last node in the list.
  */
 #define list_append(LIST, NODE) {\
-	if(*(LIST) == (void*) 0) {\
+	list_stat_(appends, 1);\
+	list_append_(LIST, NODE)\
+}
+
+/* list_append without counting it as an append */
+#define list_append_(LIST, NODE) {\
+	if(*(LIST) == list_null_) {\
 		*(LIST) = (NODE);\
 		(NODE)->next = (NODE);\
 		(NODE)->prev = (NODE);\
@@ -100,7 +417,8 @@ PERFORMANCE OF THIS SOFTWARE.
  * calling list_append and updating the head of the list to NODE.
  */
 #define list_prepend(LIST, NODE) {\
-	list_append(LIST, NODE)\
+	list_stat_(prepends, 1);\
+	list_append_(LIST, NODE)\
 	*LIST = NODE;\
 }
 
@@ -111,6 +429,7 @@ PERFORMANCE OF THIS SOFTWARE.
  * 	AFTER has to be in LIST
  */
 #define list_insert_after(LIST, NODE, AFTER) {\
+	list_stat_(inserts, 1);\
 	(NODE)->prev = (AFTER);\
 	(NODE)->next = (AFTER)->next;\
 	(AFTER)->next->prev = (NODE);\
@@ -124,6 +443,7 @@ PERFORMANCE OF THIS SOFTWARE.
  * 	BEFORE has to be in LIST
  */
 #define list_insert_before(LIST, NODE, BEFORE) {\
+	list_stat_(inserts, 1);\
 	(NODE)->prev = (BEFORE)->prev;\
 	(NODE)->next = (BEFORE);\
 	(BEFORE)->prev->next = (NODE);\
@@ -136,8 +456,9 @@ PERFORMANCE OF THIS SOFTWARE.
  * This might change the head of the list when it is the one being removed.
  */
 #define list_remove(LIST, NODE) {\
+	list_stat_(removes, 1);\
 	if(*(LIST) == (NODE)) *(LIST) = (NODE)->next;\
-	if(*(LIST) == (NODE)) *(LIST) = (void*) 0;\
+	if(*(LIST) == (NODE)) *(LIST) = list_null_;\
 	else {\
 		(NODE)->next->prev = (NODE)->prev;\
 		(NODE)->prev->next = (NODE)->next;\
@@ -148,7 +469,7 @@ PERFORMANCE OF THIS SOFTWARE.
  *
  * This macro evaluates to 1 if the list is empty.
  */
-#define list_is_empty(LIST) (*(LIST) == (void*) 0)
+#define list_is_empty(LIST) (*(LIST) == list_null_)
 
 /* Iterate through each entry in the list
  *
@@ -161,8 +482,8 @@ PERFORMANCE OF THIS SOFTWARE.
  * }
  */
 #define list_foreach(LIST, NODE) for((NODE) = *(LIST);\
-		(NODE);\
-		(NODE) = ((NODE)->next == *(LIST) ? (void*) 0 : (NODE)->next))
+		list_step_(NODE);\
+		(NODE) = ((NODE)->next == *(LIST) ? list_null_ : (NODE)->next))
 
 /* Iterate through each entry in the list in reverse order
  *
@@ -175,9 +496,9 @@ PERFORMANCE OF THIS SOFTWARE.
  * }
  */
 #define list_foreach_reverse(LIST, NODE) \
-	for((NODE) = (*LIST) ? (*(LIST))->prev : (void*) 0;\
-		(NODE);\
-		(NODE) = ((NODE)->prev == (*(LIST))->prev ? (void*) 0 : \
+	for((NODE) = (*LIST) ? (*(LIST))->prev : list_null_;\
+		list_step_(NODE);\
+		(NODE) = ((NODE)->prev == (*(LIST))->prev ? list_null_ : \
 			(NODE)->prev))
 
 /* Iterate through each entry in the list safely
@@ -220,8 +541,8 @@ PERFORMANCE OF THIS SOFTWARE.
  * of foreach.
  */
 #define list_foreach_safe(LIST, NODE, TMP) for((NODE) = *(LIST);\
-		(NODE) && (\
-		((TMP) = (NODE)->next == *(LIST) ? (void*) 0 : (NODE)->next)\
+		list_step_(NODE) && (\
+		((TMP) = (NODE)->next == *(LIST) ? list_null_ : (NODE)->next)\
 		|| 1);\
 		(NODE) = (TMP))
 
@@ -239,10 +560,10 @@ PERFORMANCE OF THIS SOFTWARE.
  * }
  */
 #define list_foreach_reverse_safe(LIST, NODE, TMP)\
-	for((NODE) = (*LIST) ? (*(LIST))->prev : (void*) 0;\
-		(NODE) && (\
+	for((NODE) = (*LIST) ? (*(LIST))->prev : list_null_;\
+		list_step_(NODE) && (\
 		((TMP) = (NODE)->prev == (*(LIST))->prev ? \
-		(void*) 0 : (NODE)->prev)\
+		list_null_ : (NODE)->prev)\
 		|| 1);\
 		(NODE) = (TMP))
 
@@ -258,93 +579,3557 @@ PERFORMANCE OF THIS SOFTWARE.
  * }
  */
 #define list_foreach_until(LIST, NODE, UNTIL) for((NODE) = *(LIST);\
-		(NODE);\
-		(NODE) = ((NODE)->next == (UNTIL) ? (void*) 0 : (NODE)->next))
+		list_step_(NODE);\
+		(NODE) = ((NODE)->next == (UNTIL) ? list_null_ : (NODE)->next))
 
+/* Iterate through the rest of the list starting at a certain node
+ *
+ * Like list_foreach, but the first node visited is START instead of the first
+ * node of the list. Nothing is visited if START is NULL.
+ */
+#define list_foreach_from(LIST, NODE, START) for((NODE) = (START);\
+		list_step_(NODE);\
+		(NODE) = ((NODE)->next == *(LIST) ? list_null_ : (NODE)->next))
 
-/* Dynamic arrays
+/* Generic node access
  *
- *         true memory pointer
- *         V
- * memory: | ARRAY METADATA |[ Element 0 ][ Element 1 ][ Element 2 ]
- *                           ^
- *                           the pointer you get
+ * Operations that need loops or temporary nodes are implemented as functions on
+ * void pointers. They find the /next/ and /prev/ members through their byte
+ * offsets inside the node struct, which the macros calculate from the nodes of
+ * the list. This keeps them working with any node struct, just like the
+ * macros above.
+ */
+#define list_link_(N, OFF) (*(void**) ((char*) (N) + (OFF)))
+
+/* Offsets of /next/ and /prev/ in the nodes of LIST, which must not be empty */
+#define list_offsets_(LIST) \
+	(size_t) ((char*) &(*(LIST))->next - (char*) *(LIST)), \
+	(size_t) ((char*) &(*(LIST))->prev - (char*) *(LIST))
+
+/* Appends the list starting at B to the list starting at A */
+static inline void list_concat_(void *a, void *b, size_t next, size_t prev) {
+	void *a_tail, *b_tail;
+
+	a_tail = list_link_(a, prev);
+	b_tail = list_link_(b, prev);
+
+	list_link_(a_tail, next) = b;
+	list_link_(b, prev) = a_tail;
+	list_link_(b_tail, next) = a;
+	list_link_(a, prev) = b_tail;
+}
+
+/* Cuts the list starting at HEAD in front of AT, which must not be HEAD */
+static inline void list_split_(void *head, void *at, size_t next, size_t prev) {
+	void *tail, *before;
+
+	tail = list_link_(head, prev);
+	before = list_link_(at, prev);
+
+	list_link_(before, next) = head;
+	list_link_(head, prev) = before;
+	list_link_(tail, next) = at;
+	list_link_(at, prev) = tail;
+}
+
+/* Moves HEAD by K nodes, backwards if K is negative */
+static inline void *list_rotate_(void *head, long k, size_t next, size_t prev) {
+	for(; k > 0; k--) head = list_link_(head, next);
+	for(; k < 0; k++) head = list_link_(head, prev);
+
+	return head;
+}
+
+/* Append all nodes of the list B to the list A
  *
- * These arrays grow as more and more elements are added.
- * All of the elements contained in the array have to be of the same size.
+ * B is empty afterwards. This only takes a constant amount of pointer updates,
+ * no matter how many nodes both lists have.
+ */
+#define list_concat(A, B) {\
+	list_stat_(splices, 1);\
+	if(*(A) && *(B)) list_concat_(*(A), *(B), list_offsets_(A));\
+	else if(*(B)) *(A) = *(B);\
+	*(B) = list_null_;\
+}
+
+/* Insert all nodes of the list OTHER after a node
  *
- * This metadata struct gets put at the front of the allocated memory block.
- * The array pointer starts after this metadata struct, as such the resulting
- * pointer can be used like a normal C array.
+ * The nodes of OTHER keep their order and OTHER is empty afterwards.
+ * This only takes a constant amount of pointer updates.
  *
- * It is incredibly important that you do not attempt to free the dynamic array
- * by itself! Always use the array_free macro.
+ * Requirements:
+ * 	LIST has to have at least one node
+ * 	AFTER has to be in LIST
  */
-struct dyn_array_data {
-	int count; // amount of elements in array
-	int alloc; // amount of elements allocated
-	int esize; // bytes in a single element
-};
+#define list_splice_after(LIST, AFTER, OTHER) {\
+	list_stat_(splices, 1);\
+	if(*(OTHER)) list_concat_((AFTER)->next, *(OTHER), list_offsets_(OTHER));\
+	*(OTHER) = list_null_;\
+}
 
-#define dyn_array_msize sizeof(struct dyn_array_data)
+/* Split a list into two lists
+ *
+ * All nodes from AT up to the end of LIST are moved to the list OUT, which has
+ * to be empty. When AT is the head of LIST, the whole list is moved and LIST is
+ * empty afterwards. This only takes a constant amount of pointer updates.
+ *
+ * Requirements:
+ * 	AT has to be in LIST
+ */
+#define list_split(LIST, AT, OUT) {\
+	list_stat_(splices, 1);\
+	if((AT) == *(LIST)) {\
+		*(OUT) = *(LIST);\
+		*(LIST) = list_null_;\
+	}\
+	else {\
+		*(OUT) = (AT);\
+		list_split_(*(LIST), *(OUT), list_offsets_(LIST));\
+	}\
+}
 
-/* Get the pointer to the metadata of the dynamic array
+/* Rotate a list by K nodes
  *
- * This pointer is equivalent to the true memory pointer of the array.
+ * The node K places after the head becomes the new head. Negative values of K
+ * rotate backwards, so list_rotate(LIST, -1) makes the last node the head.
+ * Because the list is circular no links have to be changed, only the head is
+ * moved, which takes |K| steps.
  */
-#define array_meta(A) (((struct dyn_array_data*) (void*) (A)) - 1)
+#define list_rotate(LIST, K) {\
+	if(*(LIST)) *(LIST) = list_cast_(*(LIST),\
+			list_rotate_(*(LIST), (K), list_offsets_(LIST)));\
+}
 
-/* Reverse of array_meta
+/* Comparison function for sorting
  *
- * Calculates the array pointer of the given memory pointer.
+ * Gets two nodes and returns a negative value when the first one goes first, a
+ * positive value when the second one goes first and 0 if they are equal, like
+ * the function passed to qsort.
  */
-#define array_ptr_off(P) ((void*) ((struct dyn_array_data*) (P) + 1))
+typedef int (*list_cmp_t)(const void *a, const void *b);
 
-/* Amount of elements in an array
+/* Merges two sorted NULL terminated chains of nodes linked by /next/
+ *
+ * Nodes of A go first if they compare equal to nodes of B.
  */
-#define array_len(A) (array_meta(A)->count)
+static inline void *list_merge_(void *a, void *b, size_t next, list_cmp_t cmp) {
+	void *head, **tail;
 
-/* Amount of elements allocated by the array
+	tail = &head;
+	while(a && b) {
+		if(cmp(b, a) < 0) {
+			*tail = b;
+			tail = &list_link_(b, next);
+			b = *tail;
+		}
+		else {
+			*tail = a;
+			tail = &list_link_(a, next);
+			a = *tail;
+		}
+	}
+	*tail = a ? a : b;
+
+	return head;
+}
+
+/* Restores the /prev/ links of a NULL terminated chain and closes the circle */
+static inline void list_relink_(void *head, size_t next, size_t prev) {
+	void *node, *last;
+
+	last = head;
+	for(node = list_link_(head, next); node; node = list_link_(node, next)) {
+		list_link_(node, prev) = last;
+		last = node;
+	}
+	list_link_(last, next) = head;
+	list_link_(head, prev) = last;
+}
+
+/* Sorts the list starting at HEAD and returns the new head
+ *
+ * This is a bottom-up merge sort: Nodes are taken off the list one by one and
+ * merged into sorted runs of 1, 2, 4, ... nodes, like incrementing a binary
+ * counter. Only /next/ is used while merging, /prev/ is fixed afterwards.
  */
-#define array_allocated(A) (array_meta(A)->alloc)
+static inline void *list_sort_(void *head, size_t next, size_t prev,
+		list_cmp_t cmp) {
+	int i, max;
+	void *runs[64];
+	void *node, *carry;
 
-/* Allocate a new empty array
+	// break the circle so the chain is NULL terminated
+	list_link_(list_link_(head, prev), next) = list_null_;
+
+	max = 0;
+	node = head;
+	while(node) {
+		carry = node;
+		node = list_link_(node, next);
+		list_link_(carry, next) = list_null_;
+
+		// runs[i] holds earlier nodes than carry, so it goes first
+		for(i = 0; i < max && runs[i]; i++) {
+			carry = list_merge_(runs[i], carry, next, cmp);
+			runs[i] = list_null_;
+		}
+		if(i == max) max++;
+		runs[i] = carry;
+	}
+
+	carry = list_null_;
+	for(i = 0; i < max; i++) {
+		if(runs[i]) carry = list_merge_(runs[i], carry, next, cmp);
+	}
+
+	list_relink_(carry, next, prev);
+
+	return carry;
+}
+
+/* Merges the sorted lists starting at A and B and returns the new head */
+static inline void *list_merge_sorted_(void *a, void *b, size_t next,
+		size_t prev, list_cmp_t cmp) {
+	if(!a) return b;
+	if(!b) return a;
+
+	list_link_(list_link_(a, prev), next) = list_null_;
+	list_link_(list_link_(b, prev), next) = list_null_;
+
+	a = list_merge_(a, b, next, cmp);
+	list_relink_(a, next, prev);
+
+	return a;
+}
+
+/* Sort a list
  *
- * Creates a new array and writes the pointer to the memory pointed to by P.
- * T gives the type of the array elements.
- * Thus, P should be of type T**.
+ * CMP is a list_cmp_t comparing two nodes. The sort is stable, so nodes that
+ * compare equal keep their order. Nodes are relinked in place without
+ * allocating any memory and sorting takes O(n log n) time.
  *
  * Example:
- * int* values;
- * array_new(&values, int);
+ * int cmp_value(const void *a, const void *b) {
+ * 	return ((struct node*) a)->value - ((struct node*) b)->value;
+ * }
+ *
+ * list_sort(&list, cmp_value);
  */
-#define array_new(P, T) {\
-	*(P) = array_ptr_off(calloc(1, dyn_array_msize)); \
-	array_meta((*P))->esize = sizeof(T);\
+#define list_sort(LIST, CMP) {\
+	if(*(LIST)) *(LIST) = list_cast_(*(LIST),\
+			list_sort_(*(LIST), list_offsets_(LIST), (CMP)));\
 }
 
-/* Free the array
+/* Merge two sorted lists
+ *
+ * Moves all nodes of the list B into the list A so that A stays sorted. Both
+ * lists have to be sorted according to CMP already. Nodes of A go first when
+ * nodes compare equal. B is empty afterwards.
+ *
+ * This takes linear time and doesn't allocate any memory.
  */
-#define array_free(A) free(array_meta(A))
+#define list_merge_sorted(A, B, CMP) {\
+	if(*(A) && *(B)) *(A) = list_cast_(*(A),\
+			list_merge_sorted_(*(A), *(B), list_offsets_(A), (CMP)));\
+	else if(*(B)) *(A) = *(B);\
+	*(B) = list_null_;\
+}
 
-/* Reserve a certain amount of elements
+/* Prefetching iteration
  *
- * This macro reserves the space for at least R elements in the array.
+ * Walking a list has to wait for every /next/ pointer to be loaded from memory
+ * before the node after it can be loaded. When the nodes are spread all over
+ * the heap, most of these loads miss the cache. These macros keep a second
+ * pointer DIST nodes ahead of the iteration and prefetch the node it points to
+ * on every step, so the nodes are already on their way into the cache by the
+ * time the iteration gets there.
+ *
+ * The look-ahead pointer stops at the end of the list instead of wrapping
+ * around, so it never points at a node that was already visited.
  */
-#define array_reserve(A, R) {\
-	while(array_meta(A)->alloc < (R)) {\
-		if(array_meta(A)->alloc == 0) array_meta(A)->alloc = 8;\
-		else array_meta(A)->alloc *= 2;\
-		(A) = array_ptr_off(realloc(array_meta(A), dyn_array_msize + \
-				array_meta(A)->alloc * array_meta(A)->esize));\
-	}\
+#if defined(__GNUC__) || defined(__clang__)
+#define list_prefetch_(P) __builtin_prefetch(P)
+#else
+#define list_prefetch_(P) ((void) (P))
+#endif
+
+/* Moves the look-ahead pointer AHEAD one node along the link at offset LINK
+ *
+ * Returns NULL once the look-ahead reaches NODE or wraps around to STOP.
+ */
+static inline void *list_prefetch_next_(void *ahead, void *node, void *stop,
+		size_t link) {
+	if(!ahead || ahead == node) return list_null_;
+
+	ahead = list_link_(ahead, link);
+	if(ahead == stop) return list_null_;
+
+	list_prefetch_(ahead);
+
+	return ahead;
 }
 
-/* Add a value to the end of an array
+/* Moves the look-ahead pointer DIST nodes ahead of START */
+static inline void *list_prefetch_start_(void *start, size_t link, int dist) {
+	void *ahead;
+
+	for(ahead = start; ahead && dist > 0; dist--) {
+		ahead = list_prefetch_next_(ahead, list_null_, start, link);
+	}
+
+	return ahead;
+}
+
+#define list_offset_(NODE, MEMBER) \
+	((size_t) ((char*) &(NODE)->MEMBER - (char*) (NODE)))
+
+/* Iterate through each entry in the list while prefetching
+ *
+ * Like list_foreach, but the node DIST nodes ahead of NODE is prefetched on
+ * every step. Good values for DIST are usually between 4 and 16.
+ *
+ * Note that this is made of two nested loops, the outer one only holds the
+ * look-ahead pointer and runs once. break still ends the whole iteration.
+ *
+ * Example:
+ * struct node *list, *node;
+ * list_foreach_prefetch(&list, node, 8) {
+ * 	printf("%d\n", node->some_value);
+ * }
  */
-#define array_append(A, E) {\
-	array_reserve(A, array_len(A) + 1);\
-	(A)[array_meta(A)->count++] = (E);\
+#define list_foreach_prefetch(LIST, NODE, DIST) \
+	for(void *list_ahead_ = *(LIST) ? list_prefetch_start_(*(LIST),\
+				list_offset_(*(LIST), next), (DIST)) : list_null_,\
+			*list_once_ = *(LIST);\
+		list_once_;\
+		list_once_ = list_null_)\
+	for((NODE) = *(LIST);\
+		list_step_(NODE);\
+		list_ahead_ = list_prefetch_next_(list_ahead_, (NODE), *(LIST),\
+			list_offset_(NODE, next)),\
+		(NODE) = ((NODE)->next == *(LIST) ? list_null_ : (NODE)->next))
+
+/* Iterate through each entry in the list in reverse order while prefetching
+ */
+#define list_foreach_prefetch_reverse(LIST, NODE, DIST) \
+	for(void *list_ahead_ = *(LIST) ? list_prefetch_start_((*(LIST))->prev,\
+				list_offset_(*(LIST), prev), (DIST)) : list_null_,\
+			*list_once_ = *(LIST);\
+		list_once_;\
+		list_once_ = list_null_)\
+	for((NODE) = (*(LIST))->prev;\
+		list_step_(NODE);\
+		list_ahead_ = list_prefetch_next_(list_ahead_, (NODE),\
+			(*(LIST))->prev, list_offset_(NODE, prev)),\
+		(NODE) = ((NODE)->prev == (*(LIST))->prev ? list_null_ : \
+			(NODE)->prev))
+
+/* Iterate through each entry in the list safely while prefetching
+ *
+ * Like list_foreach_safe, the current node can be removed. The look-ahead
+ * pointer is moved before the body runs, so it never points at the current
+ * node while it might be freed.
+ */
+#define list_foreach_prefetch_safe(LIST, NODE, TMP, DIST) \
+	for(void *list_ahead_ = *(LIST) ? list_prefetch_start_(*(LIST),\
+				list_offset_(*(LIST), next), (DIST)) : list_null_,\
+			*list_once_ = *(LIST);\
+		list_once_;\
+		list_once_ = list_null_)\
+	for((NODE) = *(LIST);\
+		list_step_(NODE) && (\
+		((TMP) = (NODE)->next == *(LIST) ? list_null_ : (NODE)->next),\
+		(list_ahead_ = list_prefetch_next_(list_ahead_, (NODE), *(LIST),\
+			list_offset_(NODE, next))),\
+		1);\
+		(NODE) = (TMP))
+
+/* Iterate in reverse order through each entry in the list safely while
+ * prefetching
+ */
+#define list_foreach_prefetch_reverse_safe(LIST, NODE, TMP, DIST) \
+	for(void *list_ahead_ = *(LIST) ? list_prefetch_start_((*(LIST))->prev,\
+				list_offset_(*(LIST), prev), (DIST)) : list_null_,\
+			*list_once_ = *(LIST);\
+		list_once_;\
+		list_once_ = list_null_)\
+	for((NODE) = (*(LIST))->prev;\
+		list_step_(NODE) && (\
+		((TMP) = (NODE)->prev == (*(LIST))->prev ? \
+		list_null_ : (NODE)->prev),\
+		(list_ahead_ = list_prefetch_next_(list_ahead_, (NODE),\
+			(*(LIST))->prev, list_offset_(NODE, prev))),\
+		1);\
+		(NODE) = (TMP))
+
+/* Lock-free multi-producer queues
+ *
+ * A list_mpsc collects nodes pushed by any amount of threads without a lock.
+ * The consumer takes everything queued so far in one go with
+ * list_mpsc_pop_all, which turns the nodes into a normal circular list in the
+ * order they were pushed. Nodes use the same /next/ and /prev/ elements as the
+ * nodes of any other list, so a node can go from a list into a queue and back.
+ *
+ * Pushing only updates the /next/ element of the node and swings the top of the
+ * queue to it with a compare-and-swap. Taking the nodes out swaps the top with
+ * NULL, so every node ends up in exactly one batch, which also makes calling
+ * list_mpsc_pop_all from several threads safe. The /prev/ links are only
+ * written after the nodes were taken out of the queue.
+ *
+ * These use the __atomic builtins of GCC and Clang, which follow the C11 memory
+ * model and work in C++ code as well.
+ *
+ * Example:
+ * struct list_mpsc queue;
+ * struct node *batch, *node;
+ * list_mpsc_init(&queue, struct node);
+ *
+ * // any producer thread
+ * list_mpsc_push(&queue, node);
+ *
+ * // consumer thread
+ * batch = NULL;
+ * list_mpsc_pop_all(&queue, &batch);
+ * list_foreach(&batch, node) {
+ * 	printf("%d\n", node->some_value);
+ * }
+ */
+#if defined(__GNUC__) || defined(__clang__)
+
+struct list_mpsc {
+	void *top; // most recently pushed node, linked to older ones by /next/
+	size_t next; // offset of /next/ in the nodes
+	size_t prev; // offset of /prev/ in the nodes
+};
+
+static inline void list_mpsc_push_(struct list_mpsc *q, void *node) {
+	void *top;
+
+	top = __atomic_load_n(&q->top, __ATOMIC_RELAXED);
+	do {
+		list_link_(node, q->next) = top;
+	} while(!__atomic_compare_exchange_n(&q->top, &top, node, 1,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static inline void *list_mpsc_pop_all_(struct list_mpsc *q, void *list) {
+	void *node, *older, *head, *tail;
+
+	node = __atomic_exchange_n(&q->top, list_null_, __ATOMIC_ACQUIRE);
+	if(!node) return list;
+
+	// the newest node becomes the tail, every older one is put in front
+	head = tail = node;
+	for(node = list_link_(node, q->next); node; node = older) {
+		older = list_link_(node, q->next);
+		list_link_(node, q->next) = head;
+		list_link_(head, q->prev) = node;
+		head = node;
+	}
+	list_link_(tail, q->next) = head;
+	list_link_(head, q->prev) = tail;
+
+	if(!list) return head;
+
+	list_concat_(list, head, q->next, q->prev);
+	return list;
+}
+
+/* Initialize an empty queue for nodes of type T
+ */
+#define list_mpsc_init(Q, T) {\
+	(Q)->top = list_null_;\
+	(Q)->next = offsetof(T, next);\
+	(Q)->prev = offsetof(T, prev);\
+}
+
+/* Push a node onto the queue
+ *
+ * Safe to call from any amount of threads at the same time.
+ */
+#define list_mpsc_push(Q, NODE) list_mpsc_push_((Q), (NODE))
+
+/* Take all nodes out of the queue and append them to a list
+ *
+ * The nodes are appended to LIST in the order they were pushed. Nodes pushed by
+ * different threads are ordered by when their push took effect.
+ */
+#define list_mpsc_pop_all(Q, LIST) {\
+	*(LIST) = list_cast_(*(LIST), list_mpsc_pop_all_((Q), *(LIST)));\
+}
+
+/* Check whether a queue is empty or not
+ *
+ * With other threads pushing this is only a snapshot.
+ */
+#define list_mpsc_is_empty(Q) \
+	(__atomic_load_n(&(Q)->top, __ATOMIC_ACQUIRE) == list_null_)
+
+#endif
+
+/* Node pools
+ *
+ * memory: | CHUNK LINK |[ Node 0 ][ Node 1 ][ Node 2 ] ... [ Node CHUNK-1 ]
+ *                        ^
+ *                        first node handed out
+ *
+ * Allocating every node with its own calloc call is slow and spreads the nodes
+ * all over the heap. A pool instead carves fixed-size nodes out of large
+ * chunks and keeps released nodes in a free list so they can be handed out
+ * again. Freeing the pool frees every chunk at once, so a list that only
+ * contains pool nodes can be thrown away without walking it.
+ *
+ * Released nodes are reused before any new chunk is allocated. The first
+ * bytes of a released node are used to link the free list.
+ *
+ * Example:
+ * struct list_pool *pool;
+ * struct node *list, *node;
+ * pool = list_pool_new(struct node, 1024);
+ * list = NULL;
+ * node = list_pool_alloc(pool);
+ * list_append(&list, node);
+ * list_pool_free_list(&list, pool);
+ */
+struct list_pool {
+	size_t esize; // bytes in a single node
+	size_t chunk; // amount of nodes in a single chunk
+	size_t used; // amount of nodes handed out from the newest chunk
+	void *chunks; // newest chunk, each chunk links to the one before it
+	void *free; // released nodes waiting to be reused
+};
+
+/* Bytes in front of the nodes of a chunk
+ *
+ * This is kept at 16 bytes so nodes stay aligned like a malloc result.
+ */
+#define list_pool_hsize 16
+
+static inline struct list_pool *list_pool_new_(size_t esize, size_t chunk) {
+	struct list_pool *pool;
+
+	pool = (struct list_pool*) LIST_CALLOC(1, sizeof(struct list_pool));
+	if(!pool) return pool;
+
+	if(esize < sizeof(void*)) esize = sizeof(void*);
+	pool->esize = (esize + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+	pool->chunk = chunk ? chunk : 1;
+	pool->used = pool->chunk;
+
+	return pool;
+}
+
+static inline void *list_pool_alloc_(struct list_pool *pool) {
+	void *node, *chunk;
+
+	if(pool->free) {
+		node = pool->free;
+		pool->free = *(void**) node;
+	}
+	else {
+		if(pool->used == pool->chunk) {
+			chunk = LIST_MALLOC(list_pool_hsize +
+					pool->chunk * pool->esize);
+			if(!chunk) return chunk;
+			*(void**) chunk = pool->chunks;
+			pool->chunks = chunk;
+			pool->used = 0;
+		}
+		node = (char*) pool->chunks + list_pool_hsize +
+			pool->used++ * pool->esize;
+	}
+
+	memset(node, 0, pool->esize);
+	return node;
+}
+
+static inline void list_pool_free_(struct list_pool *pool) {
+	void *chunk, *next;
+
+	for(chunk = pool->chunks; chunk; chunk = next) {
+		next = *(void**) chunk;
+		LIST_FREE(chunk);
+	}
+	LIST_FREE(pool);
+}
+
+/* Create a new pool for nodes of type T
+ *
+ * CHUNK gives the amount of nodes allocated at once.
+ * This evaluates to a /struct list_pool * / or NULL when out of memory.
+ */
+#define list_pool_new(T, CHUNK) list_pool_new_(sizeof(T), (CHUNK))
+
+/* Take a node from the pool
+ *
+ * The node is zeroed, just like a node allocated with calloc.
+ * This evaluates to NULL when out of memory.
+ */
+#define list_pool_alloc(POOL) list_pool_alloc_(POOL)
+
+/* Give a node back to the pool
+ *
+ * The node has to be removed from any list before releasing it.
+ */
+#define list_pool_release(POOL, NODE) {\
+	*(void**) (void*) (NODE) = (POOL)->free;\
+	(POOL)->free = (void*) (NODE);\
+}
+
+/* Free the pool and all nodes allocated from it
+ *
+ * Lists containing nodes from this pool must not be used afterwards.
+ */
+#define list_pool_free(POOL) list_pool_free_(POOL)
+
+/* Free a whole list together with the pool its nodes came from
+ *
+ * Unlike removing and freeing every node with list_foreach_safe this does not
+ * touch the nodes at all. LIST is empty afterwards.
+ */
+#define list_pool_free_list(LIST, POOL) {\
+	*(LIST) = list_null_;\
+	list_pool_free(POOL);\
+}
+
+
+/* List compaction
+ *
+ * before:  A ----------> B <--- C ------------> D
+ * after:  [ A ][ B ][ C ][ D ]  (one pool chunk, in list order)
+ *
+ * Lists that have seen many inserts and removals end up with their nodes all
+ * over the heap, and iterating over them turns into one cache miss per node.
+ * list_compact copies all nodes of a list into a single pool chunk in the
+ * order of the list and relinks the copies, so iterating forwards walks
+ * through memory in order and the hardware prefetcher can keep up.
+ *
+ * The nodes are copied with memcpy, so everything else pointing at the old
+ * nodes has to be updated. For this MOVED(void *from, void *to, void *ctx) is
+ * called for every node in list order once the new list is complete. It can
+ * also free the old node, which isn't used anymore after MOVED returned.
+ * MOVED may be NULL if nothing has to be done.
+ */
+typedef void (*list_moved_t)(void *from, void *to, void *ctx);
+
+static inline struct list_pool *list_compact_(void **list, size_t size,
+		size_t next, size_t prev, list_moved_t moved, void *ctx) {
+	struct list_pool *pool;
+	void *node, *after, *before, *to, *head;
+	size_t n;
+
+	n = 0;
+	node = *list;
+	do {
+		n++;
+		node = list_link_(node, next);
+	} while(node != *list);
+
+	pool = list_pool_new_(size, n);
+	if(!pool) return pool;
+	head = list_pool_alloc_(pool);
+	if(!head) {
+		list_pool_free_(pool);
+		return list_null_;
+	}
+
+	// the chunk holds exactly n nodes, so they all follow each other
+	before = list_null_;
+	to = head;
+	node = *list;
+	do {
+		memcpy(to, node, size);
+		if(before) {
+			list_link_(before, next) = to;
+			list_link_(to, prev) = before;
+		}
+		before = to;
+		to = (char*) to + pool->esize;
+		node = list_link_(node, next);
+	} while(node != *list);
+	list_link_(before, next) = head;
+	list_link_(head, prev) = before;
+	pool->used = n;
+
+	if(moved) {
+		to = head;
+		node = *list;
+		do {
+			after = list_link_(node, next);
+			moved(node, to, ctx);
+			node = after;
+			to = (char*) to + pool->esize;
+		} while(to != (char*) head + n * pool->esize);
+	}
+
+	*list = head;
+	return pool;
+}
+
+/* Copy all nodes of a list into one block of memory in list order
+ *
+ * SIZE is the size of a single node. The copies are taken from a new pool
+ * that holds exactly these nodes, so afterwards nodes can be released to it
+ * and new ones taken from it like with any other pool. The pool is freed with
+ * list_pool_free once the list is no longer needed. MOVED and CTX are passed
+ * on to fix up pointers to the old nodes, see above.
+ *
+ * This evaluates to the new pool, or to NULL when LIST is empty or when out of
+ * memory, in which case LIST is left as it is.
+ *
+ * Example freeing the old nodes:
+ * void node_moved(void *from, void *to, void *ctx) {
+ * 	free(from);
+ * }
+ * struct list_pool *pool = list_compact(&list, sizeof(struct node),
+ * 		node_moved, NULL);
+ */
+#define list_compact(LIST, SIZE, MOVED, CTX) (*(LIST) ? \
+	list_compact_((void**) (LIST), (SIZE), list_offsets_(LIST), \
+			(MOVED), (CTX)) : list_null_)
+
+/* Dynamic arrays
+ *
+ *         true memory pointer
+ *         V
+ * memory: | ARRAY METADATA |[ Element 0 ][ Element 1 ][ Element 2 ]
+ *                           ^
+ *                           the pointer you get
+ *
+ * These arrays grow as more and more elements are added.
+ * All of the elements contained in the array have to be of the same size.
+ *
+ * This metadata struct gets put at the front of the allocated memory block.
+ * The array pointer starts after this metadata struct, as such the resulting
+ * pointer can be used like a normal C array.
+ *
+ * Arrays created by array_new_aligned may have some padding in front of the
+ * metadata, so that element 0 ends up on the requested alignment.
+ *
+ * It is incredibly important that you do not attempt to free the dynamic array
+ * by itself! Always use the array_free macro.
+ *
+ * The layout of the metadata is stable: array_save writes it to files and
+ * code outside of this file may read it. Fields are only ever added at the
+ * end, and the size stays a multiple of 16 bytes so element 0 keeps the
+ * alignment of a malloc result. Files from an older layout are recognized by
+ * ARRAY_FILE_VERSION.
+ */
+
+/* Allocator of a single array
+ *
+ * This works like realloc: P is the block to resize or NULL for a new block,
+ * OLD gives its current size in bytes and SIZE the size it needs. A SIZE of 0
+ * frees the block. CTX is the context the array was created with, for example
+ * an arena. Returns the block or NULL when out of memory.
+ */
+typedef void *(*array_allocator_t)(void *ctx, void *p, size_t old,
+		size_t size);
+
+struct dyn_array_data {
+	size_t count; // amount of elements in array
+	size_t alloc; // amount of elements allocated
+	size_t esize; // bytes in a single element
+	size_t threshold; // capacity from which on the growth policy is used
+	size_t step; // elements added at once by ARRAY_GROW_STEP
+	size_t head; // index of the first element of a ring buffer
+	uint32_t align; // alignment of element 0, 0 if not aligned explicitly
+	uint32_t pad; // bytes between the true memory pointer and the metadata
+	int growth; // growth policy, see array_set_growth
+	int mode; // allocation mode, see array_set_mode
+	array_allocator_t allocator; // NULL for LIST_REALLOC and LIST_FREE
+	void *allocator_ctx; // context passed to the allocator
+};
+
+#define dyn_array_msize sizeof(struct dyn_array_data)
+typedef char dyn_array_msize_check_[dyn_array_msize % 16 == 0 ? 1 : -1];
+
+/* Growth policies
+ *
+ * Below the threshold of an array its capacity is always doubled. From the
+ * threshold on, the growth policy decides how much room is added:
+ * 	ARRAY_GROW_DOUBLE	double the capacity (the default)
+ * 	ARRAY_GROW_HALF		grow the capacity by half, wasting at most a
+ * 				third of the memory instead of half
+ * 	ARRAY_GROW_STEP		add a fixed amount of elements
+ */
+#define ARRAY_GROW_DOUBLE 0
+#define ARRAY_GROW_HALF 1
+#define ARRAY_GROW_STEP 2
+
+/* Works out the capacity for at least R elements according to the policy */
+static inline size_t array_grow_(const struct dyn_array_data *meta, size_t r) {
+	size_t alloc;
+
+	alloc = meta->alloc ? meta->alloc : 8;
+
+	while(alloc < r) {
+		if(alloc < meta->threshold || meta->growth == ARRAY_GROW_DOUBLE) {
+			alloc *= 2;
+		}
+		else if(meta->growth == ARRAY_GROW_HALF) {
+			alloc += alloc / 2;
+		}
+		else if(meta->step) {
+			// jump straight to the last step
+			alloc += (r - alloc + meta->step - 1) / meta->step * meta->step;
+		}
+		else {
+			alloc *= 2;
+		}
+	}
+
+	return alloc;
+}
+
+/* Get the pointer to the metadata of the dynamic array
+ *
+ * This pointer is equivalent to the true memory pointer of the array.
+ */
+#define array_meta(A) (((struct dyn_array_data*) (void*) (A)) - 1)
+
+/* Reverse of array_meta
+ *
+ * Calculates the array pointer of the given memory pointer.
+ */
+#define array_ptr_off(P) ((void*) ((struct dyn_array_data*) (P) + 1))
+
+/* Amount of elements in an array
+ */
+#define array_len(A) (array_meta(A)->count)
+
+/* Amount of elements allocated by the array
+ */
+#define array_allocated(A) (array_meta(A)->alloc)
+
+/* Set the growth policy of an array
+ *
+ * GROWTH is one of the ARRAY_GROW_* policies, which is used once the capacity
+ * reaches THRESHOLD elements. STEP is the amount of elements ARRAY_GROW_STEP
+ * adds at once and has to be larger than 0 for that policy.
+ *
+ * Example growing by 1.5x above a million elements:
+ * array_set_growth(values, ARRAY_GROW_HALF, 1000000, 0);
+ */
+#define array_set_growth(A, GROWTH, THRESHOLD, STEP) {\
+	array_meta(A)->growth = (GROWTH);\
+	array_meta(A)->threshold = (THRESHOLD);\
+	array_meta(A)->step = (STEP);\
+}
+
+/* Allocation modes
+ *
+ * By default the memory of an array comes from the heap. Very large arrays can
+ * instead be backed by anonymous memory mappings:
+ * 	ARRAY_MODE_HEAP		use LIST_REALLOC (the default)
+ * 	ARRAY_MODE_MMAP		once the array needs ARRAY_MMAP_THRESHOLD bytes,
+ * 				move it into an anonymous mapping and grow it with
+ * 				mremap, which remaps the pages instead of copying
+ * 	ARRAY_MODE_HUGE		like ARRAY_MODE_MMAP, but additionally ask for
+ * 				transparent huge pages to cut down on TLB misses
+ *
+ * The mapped modes are only available on Linux. Everywhere else they behave
+ * like ARRAY_MODE_HEAP.
+ */
+#define ARRAY_MODE_HEAP 0
+#define ARRAY_MODE_MMAP 1
+#define ARRAY_MODE_HUGE 3
+#define ARRAY_MAPPED_ 4
+#define ARRAY_FILE_ 8
+
+#ifndef ARRAY_MMAP_THRESHOLD
+#define ARRAY_MMAP_THRESHOLD ((size_t) 1 << 24)
+#endif
+
+#if defined(__linux__) && defined(MAP_ANONYMOUS)
+#define ARRAY_HAS_MMAP_ 1
+#ifndef _GNU_SOURCE
+extern void *mremap(void *addr, size_t old_len, size_t new_len, int flags, ...);
+#endif
+#ifndef MREMAP_MAYMOVE
+#define MREMAP_MAYMOVE 1
+#endif
+#else
+#define ARRAY_HAS_MMAP_ 0
+#endif
+
+/* Bytes of memory needed by an array with ALLOC elements */
+static inline size_t array_bytes_(const struct dyn_array_data *meta,
+		size_t alloc) {
+	return dyn_array_msize + alloc * meta->esize +
+			(meta->align ? meta->align - 1 : 0);
+}
+
+/* Resizes the block P of an array from OLD to SIZE bytes */
+static inline void *array_realloc_(const struct dyn_array_data *meta, void *p,
+		size_t old, size_t size) {
+	if(meta->allocator) {
+		return meta->allocator(meta->allocator_ctx, p, old, size);
+	}
+	return LIST_REALLOC(p, size);
+}
+
+/* Frees the block P of SIZE bytes of an array */
+static inline void array_dealloc_(const struct dyn_array_data *meta, void *p,
+		size_t size) {
+	if(meta->allocator) {
+		meta->allocator(meta->allocator_ctx, p, size, 0);
+		return;
+	}
+	LIST_FREE(p);
+}
+
+/* Amount of elements from the start of the memory of an array in use
+ *
+ * This is the length of the array, unless it is a ring buffer.
+ */
+static inline size_t array_used_(const struct dyn_array_data *meta) {
+	return meta->head + meta->count < meta->alloc ?
+			meta->head + meta->count : meta->alloc;
+}
+
+/* Moves the array in the memory block P to the alignment of the array
+ *
+ * PAD gives the amount of bytes in front of the metadata in P and USED the
+ * amount of elements to move along, returns the array.
+ */
+static inline void *array_place_(char *p, size_t pad, size_t used) {
+	struct dyn_array_data *meta;
+	size_t align, to;
+
+	meta = (struct dyn_array_data*) (void*) (p + pad);
+	align = meta->align;
+	to = align ? (align - ((uintptr_t) p + dyn_array_msize) % align) % align : 0;
+
+	if(to != pad) {
+		memmove(p + to, meta, dyn_array_msize + used * meta->esize);
+		meta = (struct dyn_array_data*) (void*) (p + to);
+	}
+	meta->pad = (uint32_t) to;
+
+	return array_ptr_off(meta);
+}
+
+/* Resizes the memory of array A to ALLOC elements, returns the new array
+ *
+ * When out of memory this returns NULL and A is left as it is.
+ */
+static inline void *array_resize_(void *a, size_t alloc) {
+	struct dyn_array_data *meta;
+	size_t old, size, pad, used;
+	char *block, *p;
+
+	meta = array_meta(a);
+	pad = meta->pad;
+	used = array_used_(meta);
+	block = (char*) meta - pad;
+	old = array_bytes_(meta, meta->alloc);
+	size = array_bytes_(meta, alloc);
+
+#if ARRAY_HAS_MMAP_
+	if(meta->mode & ARRAY_FILE_) {
+		// arrays mapped from a file move to the heap before they change
+		p = (char*) array_realloc_(meta, list_null_, 0, size);
+		if(!p) {
+			return list_null_;
+		}
+		memcpy(p, meta, dyn_array_msize + used * meta->esize);
+		munmap(block, pad + dyn_array_msize + meta->alloc * meta->esize);
+		((struct dyn_array_data*) (void*) p)->mode &=
+				~(ARRAY_MAPPED_ | ARRAY_FILE_);
+		// the mapping of the file was never counted as allocated
+		old = 0;
+		pad = 0;
+	}
+	else if(meta->mode & ARRAY_MAPPED_) {
+		p = (char*) mremap(block, old, size, MREMAP_MAYMOVE);
+		if(p == MAP_FAILED) {
+			return list_null_;
+		}
+	}
+	else if((meta->mode & ARRAY_MODE_MMAP) && size >= ARRAY_MMAP_THRESHOLD) {
+		// copy the heap block once, from then on the pages are remapped
+		p = (char*) mmap(list_null_, size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(p == MAP_FAILED) {
+			p = (char*) array_realloc_(meta, block, old, size);
+		}
+		else {
+			memcpy(p + pad, meta, dyn_array_msize + used * meta->esize);
+			array_dealloc_(meta, block, old);
+			((struct dyn_array_data*) (void*) (p + pad))->mode |=
+					ARRAY_MAPPED_;
+		}
+	}
+	else {
+		p = (char*) array_realloc_(meta, block, old, size);
+	}
+	if(!p) {
+		return list_null_;
+	}
+
+#ifdef MADV_HUGEPAGE
+	if((((struct dyn_array_data*) (void*) (p + pad))->mode &
+			(ARRAY_MODE_HUGE | ARRAY_MAPPED_)) ==
+			(ARRAY_MODE_HUGE | ARRAY_MAPPED_)) {
+		madvise(p, size, MADV_HUGEPAGE);
+	}
+#endif
+#else
+	p = (char*) array_realloc_(meta, block, old, size);
+	if(!p) {
+		return list_null_;
+	}
+#endif
+
+	((struct dyn_array_data*) (void*) (p + pad))->alloc = alloc;
+	list_stat_(reallocs, 1);
+	list_stat_bytes_(size - old);
+	if(p != block) {
+		list_stat_(bytes_moved, dyn_array_msize + used *
+				((struct dyn_array_data*) (void*) (p + pad))->esize);
+	}
+	return array_place_(p, pad, used);
+}
+
+/* Frees the memory of array A, whether it is mapped or not */
+static inline void array_free_(void *a) {
+	struct dyn_array_data *meta;
+
+	meta = array_meta(a);
+#if ARRAY_HAS_MMAP_
+	if(meta->mode & ARRAY_FILE_) {
+		munmap((char*) meta - meta->pad,
+				meta->pad + dyn_array_msize + meta->alloc * meta->esize);
+		return;
+	}
+#endif
+	list_stat_bytes_(-(int64_t) array_bytes_(meta, meta->alloc));
+#if ARRAY_HAS_MMAP_
+	if(meta->mode & ARRAY_MAPPED_) {
+		munmap((char*) meta - meta->pad, array_bytes_(meta, meta->alloc));
+		return;
+	}
+#endif
+	array_dealloc_(meta, (char*) meta - meta->pad,
+			array_bytes_(meta, meta->alloc));
+}
+
+/* Creates an empty array of ESIZE byte elements aligned to ALIGN bytes
+ *
+ * Returns NULL when out of memory.
+ */
+static inline void *array_new_aligned_(size_t esize, size_t align) {
+	struct dyn_array_data *meta;
+	char *p;
+
+	p = (char*) LIST_CALLOC(1, dyn_array_msize + (align ? align - 1 : 0));
+	if(!p) {
+		return list_null_;
+	}
+	meta = (struct dyn_array_data*) (void*) p;
+	meta->esize = esize;
+	meta->align = (uint32_t) align;
+	list_stat_bytes_(array_bytes_(meta, 0));
+
+	return array_place_(p, 0, 0);
+}
+
+/* Creates an empty array of ESIZE byte elements, NULL when out of memory */
+static inline void *array_new_(size_t esize) {
+	struct dyn_array_data *meta;
+
+	meta = (struct dyn_array_data*) LIST_CALLOC(1, dyn_array_msize);
+	if(!meta) {
+		return list_null_;
+	}
+	meta->esize = esize;
+	list_stat_bytes_(dyn_array_msize);
+
+	return array_ptr_off(meta);
+}
+
+/* Creates an empty array of ESIZE byte elements using ALLOCATOR */
+static inline void *array_new_allocator_(size_t esize,
+		array_allocator_t allocator, void *ctx) {
+	struct dyn_array_data *meta;
+
+	meta = (struct dyn_array_data*) allocator(ctx, list_null_, 0,
+			dyn_array_msize);
+	if(!meta) {
+		return list_null_;
+	}
+	memset(meta, 0, dyn_array_msize);
+	meta->esize = esize;
+	meta->allocator = allocator;
+	meta->allocator_ctx = ctx;
+	list_stat_bytes_(dyn_array_msize);
+
+	return array_ptr_off(meta);
+}
+
+/* Set the allocation mode of an array
+ *
+ * MODE is one of the ARRAY_MODE_* modes and is used the next time the array
+ * grows. An array that already lives in a mapping stays there.
+ *
+ * Example backing a large array with huge pages:
+ * array_set_mode(values, ARRAY_MODE_HUGE);
+ */
+#define array_set_mode(A, MODE) {\
+	array_meta(A)->mode = (array_meta(A)->mode & \
+			(ARRAY_MAPPED_ | ARRAY_FILE_)) | (MODE);\
+}
+
+/* Allocate a new empty array
+ *
+ * Creates a new array and writes the pointer to the memory pointed to by P.
+ * T gives the type of the array elements.
+ * Thus, P should be of type T**.
+ * The pointer is NULL when out of memory, this goes for all array_new macros.
+ *
+ * Example:
+ * int* values;
+ * array_new(&values, int);
+ */
+#define array_new(P, T) {\
+	*(P) = list_cast_(*(P), array_new_(sizeof(T)));\
+}
+
+/* Allocate a new empty array with aligned elements
+ *
+ * Same as array_new, but element 0 is placed on a multiple of ALIGN bytes,
+ * which has to be a power of two (for example 16, 32, 64 or the page size).
+ * The alignment is kept whenever the array is reallocated.
+ *
+ * Example:
+ * double *values;
+ * array_new_aligned(&values, double, 64);
+ */
+#define array_new_aligned(P, T, ALIGN) {\
+	*(P) = list_cast_(*(P), array_new_aligned_(sizeof(T), (ALIGN)));\
+}
+
+/* Allocate a new empty array with the given allocation mode
+ *
+ * Same as array_new, MODE is one of the ARRAY_MODE_* modes.
+ *
+ * Example:
+ * struct record *records;
+ * array_new_mode(&records, struct record, ARRAY_MODE_MMAP);
+ */
+#define array_new_mode(P, T, MODE) {\
+	array_new(P, T);\
+	if(*(P)) array_meta((*P))->mode = (MODE);\
+}
+
+/* Allocate a new empty array with its own allocator
+ *
+ * Same as array_new, but all memory of the array comes from ALLOCATOR, an
+ * array_allocator_t, instead of LIST_REALLOC and LIST_FREE. CTX is passed to
+ * every call of ALLOCATOR, so arrays in the same process can use different
+ * arenas. Array modes other than ARRAY_MODE_HEAP still map large arrays.
+ *
+ * Example with a bump arena that never frees:
+ * void *bump(void *ctx, void *p, size_t old, size_t size) {
+ * 	void *n = size ? arena_alloc(ctx, size) : NULL;
+ * 	if(n && p) memcpy(n, p, old < size ? old : size);
+ * 	return n;
+ * }
+ * ...
+ * int *values;
+ * array_new_allocator(&values, int, bump, &request_arena);
+ */
+#define array_new_allocator(P, T, ALLOCATOR, CTX) {\
+	*(P) = list_cast_(*(P), array_new_allocator_(sizeof(T), (ALLOCATOR), \
+			(CTX)));\
+}
+
+/* Free the array
+ *
+ * Arrays living in a memory mapping, including the ones from array_map, are
+ * unmapped.
+ */
+#define array_free(A) array_free_(A)
+
+/* Grows array A to room for at least R elements
+ *
+ * When out of memory this returns A as it is if CHECKED is set and aborts
+ * otherwise.
+ */
+static inline void *array_reserve_(void *a, size_t r, int checked) {
+	void *p;
+
+	if(array_meta(a)->alloc >= r) return a;
+
+	p = array_resize_(a, array_grow_(array_meta(a), r));
+	if(!p) {
+		if(!checked) abort();
+		return a;
+	}
+
+	return p;
+}
+
+/* Reserve a certain amount of elements
+ *
+ * This macro reserves the space for at least R elements in the array.
+ *
+ * The new capacity is worked out first according to the growth policy of the
+ * array, so the array is reallocated at most once, no matter how many times
+ * the capacity has to grow.
+ *
+ * Running out of memory aborts the program, just like it does for every
+ * macro adding elements to an array. Use array_reserve_checked first where
+ * that has to be handled.
+ */
+#define array_reserve(A, R) {\
+	if(array_meta(A)->alloc < (size_t) (R)) {\
+		(A) = list_cast_(A, array_reserve_((A), (R), 0));\
+	}\
+}
+
+/* Reserve a certain amount of elements or report running out of memory
+ *
+ * Same as array_reserve, but evaluates to 0 on success and to -1 when out of
+ * memory, in which case the array and its elements are left as they are.
+ *
+ * Example:
+ * if(array_reserve_checked(values, array_len(values) + n) < 0) return -1;
+ * array_extend(values, more, n);
+ */
+#define array_reserve_checked(A, R) \
+	((A) = list_cast_(A, array_reserve_((A), (R), 1)), \
+	array_meta(A)->alloc < (size_t) (R) ? -1 : 0)
+
+/* Add a value to the end of an array
+ */
+#define array_append(A, E) {\
+	array_reserve(A, array_len(A) + 1);\
+	(A)[array_meta(A)->count++] = (E);\
+}
+
+/* Add N copies of a value to the end of an array
+ */
+#define array_append_n(A, E, N) {\
+	size_t array_i_;\
+	array_reserve(A, array_len(A) + (N));\
+	for(array_i_ = 0; array_i_ < (size_t) (N); array_i_++)\
+		(A)[array_meta(A)->count++] = (E);\
+}
+
+/* Add N elements from SRC to the end of an array
+ *
+ * SRC is a pointer to N elements of the same type as the array elements, for
+ * example a normal C array or another dynamic array.
+ *
+ * Example:
+ * int* values;
+ * int others[] = {1, 2, 3};
+ * array_new(&values, int);
+ * array_extend(values, others, 3);
+ */
+#define array_extend(A, SRC, N) {\
+	array_reserve(A, array_len(A) + (N));\
+	memcpy((A) + array_len(A), (SRC), (N) * array_meta(A)->esize);\
+	array_meta(A)->count += (N);\
+}
+
+/* Insert N elements from SRC before the element at index IDX
+ *
+ * The elements starting at IDX are moved back to make room. IDX may be equal
+ * to the length of the array, in which case this is the same as array_extend.
+ * SRC must not point into the array itself.
+ */
+#define array_insert_n(A, IDX, SRC, N) {\
+	array_reserve(A, array_len(A) + (N));\
+	memmove((A) + (IDX) + (N), (A) + (IDX), \
+			(array_len(A) - (IDX)) * array_meta(A)->esize);\
+	list_stat_(bytes_moved, (array_len(A) - (IDX)) * array_meta(A)->esize);\
+	memcpy((A) + (IDX), (SRC), (N) * array_meta(A)->esize);\
+	array_meta(A)->count += (N);\
+}
+
+/* Saving and mapping arrays
+ *
+ *  file:  | FILE HEADER | ... | ARRAY METADATA |[ Element 0 ][ Element 1 ]...
+ *
+ * array_save writes an array to a file laid out exactly like an array in
+ * memory, behind a small header with the format version. array_map maps such
+ * a file into memory and returns it as an array without reading, parsing or
+ * copying anything, so the pages are only loaded when they are accessed.
+ *
+ * Files are only mapped if they were written with the same format version,
+ * metadata layout, byte order and element size, otherwise array_map fails.
+ * Element 0 is aligned to 64 bytes in the file, or to the alignment of the
+ * array if it was created with a larger one by array_new_aligned.
+ *
+ * Mapped arrays are freed with array_free like any other array. Saving and
+ * mapping is only available on Linux.
+ */
+#if ARRAY_HAS_MMAP_
+#define ARRAY_FILE_VERSION 2
+#define ARRAY_FILE_MAGIC_ "DYNARRAY"
+#define ARRAY_FILE_ORDER_ 0x01020304u
+
+/* How array_map maps the file
+ * 	ARRAY_MAP_READ_ONLY	the array must not be changed, appending to it
+ * 				moves it to the heap first
+ * 	ARRAY_MAP_PRIVATE	the elements may be changed, the changes are
+ * 				copy-on-write and never reach the file
+ */
+#define ARRAY_MAP_READ_ONLY 0
+#define ARRAY_MAP_PRIVATE 1
+
+struct array_file_header_ {
+	char magic[8]; // ARRAY_FILE_MAGIC_
+	uint32_t version; // ARRAY_FILE_VERSION
+	uint32_t order; // ARRAY_FILE_ORDER_ in the byte order of the writer
+	uint64_t msize; // size of the metadata
+	uint64_t esize; // bytes in a single element
+	uint64_t count; // amount of elements
+	uint64_t offset; // offset of element 0 in the file
+	uint64_t reserved[2];
+};
+
+/* Writes all N bytes at BUF to FD, returns 0 or -1 on errors */
+static inline int array_write_(int fd, const void *buf, size_t n) {
+	const char *p;
+	ssize_t w;
+
+	for(p = (const char*) buf; n > 0; p += w, n -= (size_t) w) {
+		w = write(fd, p, n);
+		if(w <= 0) return -1;
+	}
+
+	return 0;
+}
+
+/* Writes array A to PATH with room for ALLOC elements in the file
+ *
+ * Elements beyond the length of A are zero.
+ */
+static inline int array_save_(const void *a, const char *path, size_t alloc) {
+	const struct dyn_array_data *meta;
+	struct array_file_header_ h;
+	struct dyn_array_data m;
+	size_t align, first;
+	int fd, err;
+
+	meta = array_meta(a);
+	align = meta->align > 64 ? meta->align : 64;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, ARRAY_FILE_MAGIC_, sizeof(h.magic));
+	h.version = ARRAY_FILE_VERSION;
+	h.order = ARRAY_FILE_ORDER_;
+	h.msize = dyn_array_msize;
+	h.esize = meta->esize;
+	h.count = meta->count;
+	h.offset = (sizeof(h) + dyn_array_msize + align - 1) / align * align;
+
+	// the metadata as it has to look once the file is mapped
+	m = *meta;
+	m.alloc = alloc;
+	m.head = 0;
+	m.pad = (uint32_t) (h.offset - dyn_array_msize);
+	m.mode = meta->mode | ARRAY_MAPPED_ | ARRAY_FILE_;
+	// an allocator is only valid in the process that saved the array
+	m.allocator = list_null_;
+	m.allocator_ctx = list_null_;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) return -1;
+
+	// ring buffers are written starting at their head
+	first = meta->count < meta->alloc - meta->head ?
+			meta->count : meta->alloc - meta->head;
+	err = array_write_(fd, &h, sizeof(h)) ||
+		lseek(fd, (off_t) m.pad, SEEK_SET) < 0 ||
+		array_write_(fd, &m, sizeof(m)) ||
+		array_write_(fd, (const char*) a + meta->head * meta->esize,
+				first * meta->esize) ||
+		array_write_(fd, a, (meta->count - first) * meta->esize) ||
+		ftruncate(fd, (off_t) (h.offset + alloc * meta->esize)) < 0;
+
+	if(close(fd) < 0) err = 1;
+
+	return err ? -1 : 0;
+}
+
+/* Checks that the SIZE bytes at P are a file array_map can use
+ *
+ * Arrays have to be exactly as large as their length, ring buffers need a
+ * capacity that is a power of two.
+ */
+static inline int array_file_valid_(const char *p, size_t size, size_t esize,
+		int ring) {
+	const struct array_file_header_ *h;
+	const struct dyn_array_data *meta;
+
+	h = (const struct array_file_header_*) (const void*) p;
+	if(memcmp(h->magic, ARRAY_FILE_MAGIC_, sizeof(h->magic)) ||
+			h->version != ARRAY_FILE_VERSION ||
+			h->order != ARRAY_FILE_ORDER_ ||
+			h->msize != dyn_array_msize || h->esize != esize ||
+			h->offset < sizeof(*h) + dyn_array_msize ||
+			h->offset > size || h->offset % 64 ||
+			h->count > (size - h->offset) / esize) {
+		return 0;
+	}
+
+	meta = (const struct dyn_array_data*) (const void*) (p + h->offset) - 1;
+	if(ring ? !meta->alloc || (meta->alloc & (meta->alloc - 1)) ||
+			meta->alloc < h->count ||
+			meta->alloc > (size - h->offset) / esize :
+			meta->alloc != h->count) {
+		return 0;
+	}
+	return meta->count == h->count &&
+		meta->esize == esize && meta->head == 0 &&
+		meta->pad == h->offset - dyn_array_msize &&
+		(meta->mode & ARRAY_FILE_) && !meta->allocator &&
+		!meta->allocator_ctx;
+}
+
+static inline void *array_map_(const char *path, size_t esize, int flags,
+		int ring) {
+	struct stat st;
+	size_t size;
+	char *p;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0) return list_null_;
+	if(fstat(fd, &st) < 0 ||
+			(size_t) st.st_size < sizeof(struct array_file_header_)) {
+		close(fd);
+		return list_null_;
+	}
+
+	size = (size_t) st.st_size;
+	p = (char*) mmap(list_null_, size, flags == ARRAY_MAP_PRIVATE ?
+			PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED) return list_null_;
+
+	if(!array_file_valid_(p, size, esize, ring)) {
+		munmap(p, size);
+		return list_null_;
+	}
+
+	return p + ((const struct array_file_header_*) (void*) p)->offset;
+}
+
+/* Save an array to a file
+ *
+ * Evaluates to 0 on success and to -1 if the file couldn't be written.
+ * Ring buffers are written as arrays of their elements from front to back,
+ * use ring_save to map them as ring buffers again.
+ *
+ * Example:
+ * if(array_save(values, "values.bin") < 0) perror("values.bin");
+ */
+#define array_save(A, PATH) array_save_((A), (PATH), array_len(A))
+
+/* Map an array of elements of type T from a file written by array_save
+ *
+ * Writes the array pointer to the memory pointed to by P. Evaluates to 0 on
+ * success and to -1 if the file couldn't be mapped, in which case P is set to
+ * NULL. FLAGS is one of the ARRAY_MAP_* values.
+ *
+ * Example:
+ * int *values;
+ * if(array_map(&values, int, "values.bin", ARRAY_MAP_READ_ONLY) == 0) {
+ * 	printf("%zu values\n", array_len(values));
+ * 	array_free(values);
+ * }
+ */
+#define array_map(P, T, PATH, FLAGS) \
+	((*(P) = list_cast_(*(P), array_map_((PATH), sizeof(T), (FLAGS), 0))) ? \
+	 0 : -1)
+#endif
+
+/* Array kernels
+ *
+ * array_find, array_count, array_fill, array_sum and array_minmax work on
+ * arrays of 8, 16, 32 and 64 bit integers, floats and doubles. The element
+ * type is worked out from the array pointer, so there is one set of macros for
+ * all of them. Other element types, like long double, fail to compile.
+ *
+ * On x86 the kernels are vectorized with SSE2, and with AVX2 when the CPU
+ * running the program supports it. Everywhere else, or when ARRAY_NO_SIMD is
+ * defined before including this file, plain loops are used.
+ */
+#define ARRAY_KIND_UNSIGNED_ 0
+#define ARRAY_KIND_SIGNED_ 1
+#define ARRAY_KIND_FLOAT_ 2
+
+#if !defined(ARRAY_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && \
+		(defined(__x86_64__) || defined(__i386__))
+#define ARRAY_HAS_SIMD_ 1
+#else
+#define ARRAY_HAS_SIMD_ 0
+#endif
+
+/* Kind of the elements of array A, one of the ARRAY_KIND_* values */
+#define array_kind_(A) ((__typeof__(*(A))) 1 / 2 != 0 ? ARRAY_KIND_FLOAT_ : \
+		(__typeof__(*(A))) -1 > 0 ? ARRAY_KIND_UNSIGNED_ : ARRAY_KIND_SIGNED_)
+
+/* Size of the elements of array A
+ *
+ * Fails to compile, with a negative array size, for element types there is no
+ * kernel for.
+ */
+#define array_esize_(A) (sizeof(char[array_kind_(A) == ARRAY_KIND_FLOAT_ ? \
+		(sizeof(*(A)) == 4 || sizeof(*(A)) == 8 ? 1 : -1) : \
+		sizeof(*(A)) <= 8 && (sizeof(*(A)) & (sizeof(*(A)) - 1)) == 0 ? \
+		1 : -1]) * sizeof(*(A)))
+
+/* Value V converted to the element type of A, passed as integer bits or as a
+ * double depending on the kind of the elements.
+ */
+#define array_bits_(A, V) (array_kind_(A) == ARRAY_KIND_FLOAT_ ? 0 : \
+		(uint64_t) (int64_t) (__typeof__(*(A))) (V))
+#define array_real_(A, V) (array_kind_(A) == ARRAY_KIND_FLOAT_ ? \
+		(double) (__typeof__(*(A))) (V) : 0)
+
+/* Calls K for every supported element type
+ *
+ * K gets the type suffix, the element type, the integer type of a comparison
+ * result, the type sums are accumulated in and which of bits or real holds
+ * the value, followed by the arguments passed to this macro.
+ */
+#define ARRAY_KERNEL_TYPES_(K, ...) \
+	K(u8, uint8_t, int8_t, uint64_t, bits, __VA_ARGS__)\
+	K(i8, int8_t, int8_t, uint64_t, bits, __VA_ARGS__)\
+	K(u16, uint16_t, int16_t, uint64_t, bits, __VA_ARGS__)\
+	K(i16, int16_t, int16_t, uint64_t, bits, __VA_ARGS__)\
+	K(u32, uint32_t, int32_t, uint64_t, bits, __VA_ARGS__)\
+	K(i32, int32_t, int32_t, uint64_t, bits, __VA_ARGS__)\
+	K(u64, uint64_t, int64_t, uint64_t, bits, __VA_ARGS__)\
+	K(i64, int64_t, int64_t, uint64_t, bits, __VA_ARGS__)\
+	K(f32, float, int32_t, double, real, __VA_ARGS__)\
+	K(f64, double, int64_t, double, real, __VA_ARGS__)
+
+/* Plain loops, used for the tails of the vectorized kernels as well */
+#define ARRAY_SCALAR_KERNELS_(S, T, M, ACC, VAL, L) \
+static inline size_t array_find_##S##_##L##_(const void *p, size_t n, \
+		uint64_t bits, double real) {\
+	const T *a = (const T*) p;\
+	T v = (T) VAL;\
+	size_t i;\
+	(void) bits; (void) real;\
+	for(i = 0; i < n; i++) if(a[i] == v) return i;\
+	return n;\
+}\
+static inline size_t array_count_##S##_##L##_(const void *p, size_t n, \
+		uint64_t bits, double real) {\
+	const T *a = (const T*) p;\
+	T v = (T) VAL;\
+	size_t i, c;\
+	(void) bits; (void) real;\
+	for(i = 0, c = 0; i < n; i++) c += a[i] == v;\
+	return c;\
+}\
+static inline void array_fill_##S##_##L##_(void *p, size_t n, \
+		uint64_t bits, double real) {\
+	T *a = (T*) p;\
+	T v = (T) VAL;\
+	size_t i;\
+	(void) bits; (void) real;\
+	for(i = 0; i < n; i++) a[i] = v;\
+}\
+static inline void array_sum_##S##_##L##_(const void *p, size_t n, void *sum) {\
+	const T *a = (const T*) p;\
+	ACC s;\
+	size_t i;\
+	for(i = 0, s = 0; i < n; i++) s += (ACC) a[i];\
+	*(ACC*) sum = s;\
+}\
+static inline void array_minmax_##S##_##L##_(const void *p, size_t n, \
+		void *min, void *max) {\
+	const T *a = (const T*) p;\
+	T lo, hi;\
+	size_t i;\
+	if(!n) return;\
+	for(i = 1, lo = hi = a[0]; i < n; i++) {\
+		if(a[i] < lo) lo = a[i];\
+		if(a[i] > hi) hi = a[i];\
+	}\
+	*(T*) min = lo;\
+	*(T*) max = hi;\
+}
+
+/* Kernels working on W bytes at once
+ *
+ * These are written with the vector extensions of GCC and clang, ATTR selects
+ * the instruction set they are compiled for. Whatever doesn't fill a whole
+ * vector is left to the plain loops.
+ */
+#define ARRAY_VECTOR_KERNELS_(S, T, M, ACC, VAL, L, W, ATTR) \
+typedef T array_##S##_##L##_v_ __attribute__((vector_size(W)));\
+typedef T array_##S##_##L##_u_ \
+		__attribute__((vector_size(W), aligned(1), may_alias));\
+typedef M array_##S##_##L##_m_ __attribute__((vector_size(W)));\
+typedef uint64_t array_##S##_##L##_q_ __attribute__((vector_size(W)));\
+typedef T array_##S##_##L##_h_ \
+		__attribute__((vector_size(W / 8 * sizeof(T)), aligned(1), may_alias));\
+typedef ACC array_##S##_##L##_a_ __attribute__((vector_size(W)));\
+ATTR static inline size_t array_find_##S##_##L##_(const void *p, size_t n, \
+		uint64_t bits, double real) {\
+	const T *a = (const T*) p;\
+	T v = (T) VAL;\
+	size_t i, j;\
+	uint64_t any;\
+	array_##S##_##L##_v_ vv;\
+	array_##S##_##L##_q_ q;\
+	for(j = 0; j < W / sizeof(T); j++) vv[j] = v;\
+	for(i = 0; i + W / sizeof(T) <= n; i += W / sizeof(T)) {\
+		q = (array_##S##_##L##_q_) \
+				(*(const array_##S##_##L##_u_*) (a + i) == vv);\
+		for(j = 0, any = 0; j < W / 8; j++) any |= q[j];\
+		if(any) break;\
+	}\
+	return i + array_find_##S##_scalar_(a + i, n - i, bits, real);\
+}\
+ATTR static inline size_t array_count_##S##_##L##_(const void *p, size_t n, \
+		uint64_t bits, double real) {\
+	const T *a = (const T*) p;\
+	T v = (T) VAL;\
+	size_t i, j, k, c;\
+	array_##S##_##L##_v_ vv;\
+	array_##S##_##L##_m_ acc;\
+	for(j = 0; j < W / sizeof(T); j++) vv[j] = v;\
+	for(i = 0, c = 0; i + W / sizeof(T) <= n;) {\
+		/* matches subtract -1, flushed before 8 bit lanes overflow */\
+		acc = (array_##S##_##L##_m_) {0};\
+		for(k = 0; k < 127 && i + W / sizeof(T) <= n; \
+				k++, i += W / sizeof(T)) {\
+			acc -= (array_##S##_##L##_m_) \
+					(*(const array_##S##_##L##_u_*) (a + i) == vv);\
+		}\
+		for(j = 0; j < W / sizeof(T); j++) c += (size_t) acc[j];\
+	}\
+	return c + array_count_##S##_scalar_(a + i, n - i, bits, real);\
+}\
+ATTR static inline void array_fill_##S##_##L##_(void *p, size_t n, \
+		uint64_t bits, double real) {\
+	T *a = (T*) p;\
+	T v = (T) VAL;\
+	size_t i, j;\
+	array_##S##_##L##_v_ vv;\
+	for(j = 0; j < W / sizeof(T); j++) vv[j] = v;\
+	for(i = 0; i + W / sizeof(T) <= n; i += W / sizeof(T)) {\
+		*(array_##S##_##L##_u_*) (a + i) = vv;\
+	}\
+	array_fill_##S##_scalar_(a + i, n - i, bits, real);\
+}\
+ATTR static inline void array_sum_##S##_##L##_(const void *p, size_t n, \
+		void *sum) {\
+	const T *a = (const T*) p;\
+	ACC s;\
+	size_t i, j;\
+	array_##S##_##L##_a_ acc;\
+	acc = (array_##S##_##L##_a_) {0};\
+	/* widen W / 8 elements at a time into 64 bit lanes */\
+	for(i = 0; i + W / 8 <= n; i += W / 8) {\
+		acc += __builtin_convertvector(\
+				*(const array_##S##_##L##_h_*) (a + i), \
+				array_##S##_##L##_a_);\
+	}\
+	array_sum_##S##_scalar_(a + i, n - i, &s);\
+	for(j = 0; j < W / 8; j++) s += acc[j];\
+	*(ACC*) sum = s;\
+}\
+ATTR static inline void array_minmax_##S##_##L##_(const void *p, size_t n, \
+		void *min, void *max) {\
+	const T *a = (const T*) p;\
+	T lo, hi;\
+	size_t i, j;\
+	array_##S##_##L##_v_ x, mn, mx;\
+	array_##S##_##L##_m_ m;\
+	if(n < W / sizeof(T)) {\
+		array_minmax_##S##_scalar_(a, n, min, max);\
+		return;\
+	}\
+	mn = mx = *(const array_##S##_##L##_u_*) a;\
+	for(i = W / sizeof(T); i + W / sizeof(T) <= n; i += W / sizeof(T)) {\
+		x = *(const array_##S##_##L##_u_*) (a + i);\
+		m = (array_##S##_##L##_m_) (x < mn);\
+		mn = (array_##S##_##L##_v_) (((array_##S##_##L##_m_) x & m) | \
+				((array_##S##_##L##_m_) mn & ~m));\
+		m = (array_##S##_##L##_m_) (x > mx);\
+		mx = (array_##S##_##L##_v_) (((array_##S##_##L##_m_) x & m) | \
+				((array_##S##_##L##_m_) mx & ~m));\
+	}\
+	for(j = 0, lo = mn[0], hi = mx[0]; j < W / sizeof(T); j++) {\
+		if(mn[j] < lo) lo = mn[j];\
+		if(mx[j] > hi) hi = mx[j];\
+	}\
+	for(; i < n; i++) {\
+		if(a[i] < lo) lo = a[i];\
+		if(a[i] > hi) hi = a[i];\
+	}\
+	*(T*) min = lo;\
+	*(T*) max = hi;\
+}
+
+/* Functions of level L picking the kernel for the element type
+ *
+ * Signedness doesn't matter when comparing for equality, so find, count and
+ * fill share the unsigned kernels. R is put in front of the kernel call, to
+ * store its result.
+ */
+#define ARRAY_KERNEL_CASES_(R, OP, L, ...) \
+	case 1: R array_##OP##_u8_##L##_(__VA_ARGS__); break;\
+	case 2: R array_##OP##_u16_##L##_(__VA_ARGS__); break;\
+	case 4: R array_##OP##_u32_##L##_(__VA_ARGS__); break;\
+	case 8: R array_##OP##_u64_##L##_(__VA_ARGS__); break;\
+	case 17: R array_##OP##_i8_##L##_(__VA_ARGS__); break;\
+	case 18: R array_##OP##_i16_##L##_(__VA_ARGS__); break;\
+	case 20: R array_##OP##_i32_##L##_(__VA_ARGS__); break;\
+	case 24: R array_##OP##_i64_##L##_(__VA_ARGS__); break;\
+	case 36: R array_##OP##_f32_##L##_(__VA_ARGS__); break;\
+	case 40: R array_##OP##_f64_##L##_(__VA_ARGS__); break;
+
+#define ARRAY_KERNEL_LEVEL_(L) \
+static inline size_t array_find_##L##_(const void *a, size_t n, size_t esize, \
+		int kind, uint64_t bits, double real) {\
+	size_t r = n;\
+	switch((kind == ARRAY_KIND_SIGNED_ ? 0 : kind) * 16 + (int) esize) {\
+		ARRAY_KERNEL_CASES_(r =, find, L, a, n, bits, real)\
+	}\
+	return r;\
+}\
+static inline size_t array_count_##L##_(const void *a, size_t n, \
+		size_t esize, int kind, uint64_t bits, double real) {\
+	size_t r = 0;\
+	switch((kind == ARRAY_KIND_SIGNED_ ? 0 : kind) * 16 + (int) esize) {\
+		ARRAY_KERNEL_CASES_(r =, count, L, a, n, bits, real)\
+	}\
+	return r;\
+}\
+static inline void array_fill_##L##_(void *a, size_t n, size_t esize, \
+		int kind, uint64_t bits, double real) {\
+	switch((kind == ARRAY_KIND_SIGNED_ ? 0 : kind) * 16 + (int) esize) {\
+		ARRAY_KERNEL_CASES_(, fill, L, a, n, bits, real)\
+	}\
+}\
+static inline void array_sum_##L##_(const void *a, size_t n, size_t esize, \
+		int kind, void *sum) {\
+	switch(kind * 16 + (int) esize) {\
+		ARRAY_KERNEL_CASES_(, sum, L, a, n, sum)\
+	}\
+}\
+static inline void array_minmax_##L##_(const void *a, size_t n, \
+		size_t esize, int kind, void *min, void *max) {\
+	switch(kind * 16 + (int) esize) {\
+		ARRAY_KERNEL_CASES_(, minmax, L, a, n, min, max)\
+	}\
+}
+
+ARRAY_KERNEL_TYPES_(ARRAY_SCALAR_KERNELS_, scalar)
+ARRAY_KERNEL_LEVEL_(scalar)
+
+#if ARRAY_HAS_SIMD_
+ARRAY_KERNEL_TYPES_(ARRAY_VECTOR_KERNELS_, sse2, 16, \
+		__attribute__((target("sse2"))))
+ARRAY_KERNEL_LEVEL_(sse2)
+ARRAY_KERNEL_TYPES_(ARRAY_VECTOR_KERNELS_, avx2, 32, \
+		__attribute__((target("avx2"))))
+ARRAY_KERNEL_LEVEL_(avx2)
+
+/* Kernel functions of the best level the CPU supports */
+#define array_kernel_(OP) (__builtin_cpu_supports("avx2") ? \
+		array_##OP##_avx2_ : array_##OP##_sse2_)
+#else
+#define array_kernel_(OP) array_##OP##_scalar_
+#endif
+
+/* Index of the first element equal to V
+ *
+ * Returns the length of the array if no element is equal to V.
+ *
+ * Example:
+ * size_t idx = array_find(values, 42);
+ */
+#define array_find(A, V) array_kernel_(find)((A), array_len(A), \
+		array_esize_(A), array_kind_(A), array_bits_(A, V), array_real_(A, V))
+
+/* Amount of elements equal to V
+ */
+#define array_count(A, V) array_kernel_(count)((A), array_len(A), \
+		array_esize_(A), array_kind_(A), array_bits_(A, V), array_real_(A, V))
+
+/* Set every element of an array to V
+ */
+#define array_fill(A, V) array_kernel_(fill)((A), array_len(A), \
+		array_esize_(A), array_kind_(A), array_bits_(A, V), array_real_(A, V))
+
+/* Sum of all elements
+ *
+ * The sum is written to the variable pointed to by SUM. Integers are added up
+ * in 64 bits, wrapping around on overflow, floats and doubles are added up as
+ * doubles. The order in which floating point values are added isn't fixed, so
+ * the last bits of the result may differ from a plain loop.
+ *
+ * Example:
+ * long long total;
+ * array_sum(values, &total);
+ */
+#define array_sum(A, SUM) {\
+	if(array_kind_(A) == ARRAY_KIND_FLOAT_) {\
+		double array_sum_f_;\
+		array_kernel_(sum)((A), array_len(A), array_esize_(A), \
+				array_kind_(A), &array_sum_f_);\
+		*(SUM) = array_sum_f_;\
+	}\
+	else {\
+		uint64_t array_sum_i_;\
+		array_kernel_(sum)((A), array_len(A), array_esize_(A), \
+				array_kind_(A), &array_sum_i_);\
+		if(array_kind_(A) == ARRAY_KIND_SIGNED_) {\
+			*(SUM) = (int64_t) array_sum_i_;\
+		}\
+		else {\
+			*(SUM) = array_sum_i_;\
+		}\
+	}\
+}
+
+/* Smallest and largest element
+ *
+ * MIN and MAX point to variables of the element type. They are left
+ * untouched if the array is empty. Arrays containing NaNs give unspecified
+ * results.
+ */
+#define array_minmax(A, MIN, MAX) array_kernel_(minmax)((A), array_len(A), \
+		array_esize_(A), array_kind_(A), (MIN), (MAX))
+
+/* Ring buffers
+ *
+ *                     tail         head
+ *                     V            V
+ * memory: | METADATA |[ 4 ][ 5 ][ ][ 1 ][ 2 ][ 3 ]
+ *                    ^
+ *                    the pointer you get
+ *
+ * A ring buffer is a dynamic array whose elements wrap around the end of its
+ * memory, which makes it the circular version of an array. Elements can be
+ * added and removed at both ends in constant time, without allocating memory
+ * for every element like a list does.
+ *
+ * The capacity of a ring buffer is always a power of two, so the position of
+ * an element is found by masking instead of dividing. When pushing onto a
+ * full ring buffer its capacity is doubled. Where a fixed capacity is needed,
+ * ring_try_push_back and ring_try_push_front fail on a full ring buffer and
+ * ring_push_back_overwrite and ring_push_front_overwrite drop the element at
+ * the other end instead, for example for a sliding window.
+ *
+ * Ring buffers are freed with ring_free.
+ *
+ * Example:
+ * int *window;
+ * ring_new(&window, int, 64);
+ * ring_push_back_overwrite(window, value);
+ */
+
+/* Changes the capacity of ring buffer R to CAP elements, returns the ring
+ *
+ * CAP has to be a power of two larger than the amount of elements in R. The
+ * elements wrapping around the old end are moved with a single memcpy, either
+ * the ones at the start of the memory behind the old end or the ones at the
+ * old end to the new end, whichever are fewer.
+ *
+ * When out of memory this returns NULL and R is left as it is.
+ */
+static inline void *ring_resize_(void *r, size_t cap) {
+	struct dyn_array_data *meta;
+	size_t old, head, wrapped;
+	char *p;
+
+	old = array_meta(r)->alloc;
+	p = (char*) array_resize_(r, cap);
+	if(!p) {
+		return list_null_;
+	}
+	meta = array_meta(p);
+	head = meta->head;
+
+	if(head + meta->count > old) {
+		wrapped = head + meta->count - old;
+		if(wrapped <= old - head) {
+			memcpy(p + old * meta->esize, p, wrapped * meta->esize);
+			list_stat_(bytes_moved, wrapped * meta->esize);
+		}
+		else {
+			memcpy(p + (cap - old + head) * meta->esize,
+					p + head * meta->esize, (old - head) * meta->esize);
+			list_stat_(bytes_moved, (old - head) * meta->esize);
+			meta->head = cap - old + head;
+		}
+	}
+
+	return p;
+}
+
+/* Same as ring_resize_, but aborts when out of memory like array_reserve */
+static inline void *ring_grow_(void *r, size_t cap) {
+	void *p;
+
+	p = ring_resize_(r, cap);
+	if(!p) abort();
+
+	return p;
+}
+
+/* Gives the new ring buffer R a capacity of CAP, frees it when out of memory */
+static inline void *ring_new_(void *r, size_t cap) {
+	void *p;
+
+	if(!r) return r;
+
+	p = ring_resize_(r, cap);
+	if(!p) array_free_(r);
+
+	return p;
+}
+
+/* Smallest power of two that is at least N and at least 1 */
+static inline size_t ring_capacity_(size_t n) {
+	size_t cap;
+
+	for(cap = 1; cap < n; cap *= 2);
+
+	return cap;
+}
+
+/* Removes the first element of R, returns its index */
+static inline size_t ring_pop_front_(void *r) {
+	struct dyn_array_data *meta;
+	size_t i;
+
+	meta = array_meta(r);
+	i = meta->head;
+	meta->head = (i + 1) & (meta->alloc - 1);
+	meta->count--;
+
+	return i;
+}
+
+/* Removes the last element of R, returns its index */
+static inline size_t ring_pop_back_(void *r) {
+	struct dyn_array_data *meta;
+
+	meta = array_meta(r);
+	meta->count--;
+
+	return (meta->head + meta->count) & (meta->alloc - 1);
+}
+
+/* Allocate a new empty ring buffer
+ *
+ * Creates a ring buffer with room for at least CAP elements of type T and
+ * writes the pointer to the memory pointed to by P, which is NULL when out of
+ * memory.
+ */
+#define ring_new(P, T, CAP) {\
+	array_new(P, T);\
+	*(P) = list_cast_(*(P), ring_new_(*(P), ring_capacity_(CAP)));\
+}
+
+/* Free the ring buffer
+ */
+#define ring_free(R) array_free(R)
+
+/* Amount of elements in a ring buffer
+ */
+#define ring_len(R) array_len(R)
+
+/* Amount of elements the ring buffer can hold before it has to grow
+ */
+#define ring_capacity(R) array_allocated(R)
+
+/* Check whether a ring buffer is empty or full
+ */
+#define ring_is_empty(R) (ring_len(R) == 0)
+#define ring_is_full(R) (ring_len(R) == ring_capacity(R))
+
+/* Element at index I, counted from the front of the ring buffer
+ */
+#define ring_at(R, I) \
+	((R)[(array_meta(R)->head + (I)) & (ring_capacity(R) - 1)])
+
+/* First and last element of a ring buffer
+ *
+ * These must not be used on an empty ring buffer.
+ */
+#define ring_front(R) ring_at(R, 0)
+#define ring_back(R) ring_at(R, ring_len(R) - 1)
+
+/* Make room for at least N elements
+ */
+#define ring_reserve(R, N) {\
+	if(ring_capacity(R) < (size_t) (N)) {\
+		(R) = list_cast_(R, ring_grow_((R), ring_capacity_(N)));\
+	}\
+}
+
+/* Add a value to the end of a ring buffer
+ */
+#define ring_push_back(R, E) {\
+	if(ring_is_full(R)) {\
+		(R) = list_cast_(R, ring_grow_((R), ring_capacity(R) * 2));\
+	}\
+	ring_at(R, ring_len(R)) = (E);\
+	array_meta(R)->count++;\
+}
+
+/* Add a value to the front of a ring buffer
+ */
+#define ring_push_front(R, E) {\
+	if(ring_is_full(R)) {\
+		(R) = list_cast_(R, ring_grow_((R), ring_capacity(R) * 2));\
+	}\
+	array_meta(R)->head = (array_meta(R)->head - 1) & (ring_capacity(R) - 1);\
+	array_meta(R)->count++;\
+	ring_front(R) = (E);\
+}
+
+/* Add a value to a ring buffer without growing it
+ *
+ * These evaluate to 0, or to -1 if the ring buffer is full, in which case it
+ * is left as it is.
+ *
+ * Example:
+ * if(ring_try_push_back(queue, job) < 0) return BUSY;
+ */
+#define ring_try_push_back(R, E) (ring_is_full(R) ? -1 : \
+	(ring_at(R, ring_len(R)) = (E), array_meta(R)->count++, 0))
+
+#define ring_try_push_front(R, E) (ring_is_full(R) ? -1 : \
+	(array_meta(R)->head = (array_meta(R)->head - 1) & \
+			(ring_capacity(R) - 1), \
+	array_meta(R)->count++, ring_front(R) = (E), 0))
+
+/* Add a value to a ring buffer, dropping the element at the other end if full
+ *
+ * The capacity never changes, so the ring buffer keeps the last elements
+ * added, like a sliding window.
+ */
+#define ring_push_back_overwrite(R, E) {\
+	if(ring_is_full(R)) ring_pop_front_(R);\
+	ring_at(R, ring_len(R)) = (E);\
+	array_meta(R)->count++;\
+}
+
+#define ring_push_front_overwrite(R, E) {\
+	if(ring_is_full(R)) ring_pop_back_(R);\
+	array_meta(R)->head = (array_meta(R)->head - 1) & (ring_capacity(R) - 1);\
+	array_meta(R)->count++;\
+	ring_front(R) = (E);\
+}
+
+/* Remove the first or last element of a ring buffer
+ *
+ * These evaluate to the removed element and must not be used on an empty
+ * ring buffer.
+ *
+ * Example:
+ * int first = ring_pop_front(window);
+ */
+#define ring_pop_front(R) ((R)[ring_pop_front_(R)])
+#define ring_pop_back(R) ((R)[ring_pop_back_(R)])
+
+/* Remove the first or last element of a ring buffer without using it
+ */
+#define ring_remove_front(R) ring_pop_front_(R)
+#define ring_remove_back(R) ring_pop_back_(R)
+
+/* Remove all elements of a ring buffer
+ */
+#define ring_clear(R) {\
+	array_meta(R)->count = 0;\
+	array_meta(R)->head = 0;\
+}
+
+/* Iterate through each element in the ring buffer
+ *
+ * E is a pointer to the current element, going from the front to the back.
+ * Elements must not be added or removed while iterating.
+ *
+ * Example:
+ * int *value;
+ * ring_foreach(window, value) {
+ * 	printf("%d\n", *value);
+ * }
+ */
+#define ring_foreach(R, E) for((E) = ring_is_empty(R) ? list_null_ : \
+			&ring_front(R);\
+		(E);\
+		(E) = ((E) == &ring_back(R) ? list_null_ : \
+			(E) == (R) + ring_capacity(R) - 1 ? (R) : (E) + 1))
+
+/* Iterate through each element in the ring buffer in reverse order
+ */
+#define ring_foreach_reverse(R, E) for((E) = ring_is_empty(R) ? list_null_ : \
+			&ring_back(R);\
+		(E);\
+		(E) = ((E) == &ring_front(R) ? list_null_ : \
+			(E) == (R) ? (R) + ring_capacity(R) - 1 : (E) - 1))
+
+#if ARRAY_HAS_MMAP_
+/* Save a ring buffer to a file
+ *
+ * Same as array_save, but the file keeps room for the smallest power of two
+ * elements the ring buffer fits in, so ring_map can map it as a ring buffer.
+ */
+#define ring_save(R, PATH) \
+	array_save_((R), (PATH), ring_capacity_(ring_len(R)))
+
+/* Map a ring buffer of elements of type T from a file written by ring_save
+ *
+ * Same as array_map. Files written by array_save are only accepted if their
+ * length is a power of two. A ring buffer mapped with ARRAY_MAP_READ_ONLY
+ * must not be changed at all, pushing or popping elements needs
+ * ARRAY_MAP_PRIVATE.
+ */
+#define ring_map(P, T, PATH, FLAGS) \
+	((*(P) = list_cast_(*(P), array_map_((PATH), sizeof(T), (FLAGS), 1))) ? \
+	 0 : -1)
+#endif
+
+/* Parallel iteration
+ *
+ * list_parallel_foreach and array_parallel_foreach call a function for every
+ * node or element, spread over several threads. The work is cut into chunks
+ * which are dealt out evenly to the threads up front. A thread that runs out
+ * of chunks steals half of the chunks another thread has left, so the threads
+ * keep busy when some chunks take longer than others.
+ *
+ * Ordering guarantees:
+ * 	- every node or element is visited exactly once
+ * 	- within a chunk, nodes and elements are visited in order, chunks are
+ * 	  visited in no particular order and at the same time
+ * 	- everything done by the function has happened once the macro returns
+ *
+ * The function must not add or remove nodes or elements, and has to be safe
+ * to call from several threads at once.
+ *
+ * The threads are started by every call and joined before it returns, which
+ * costs some hundred microseconds, so small lists and arrays are better off
+ * with a plain loop. When threads can't be started or memory runs out, the
+ * calling thread does the work that is left.
+ *
+ * Lists are cut into chunks of LIST_PARALLEL_CHUNK nodes with one pass over
+ * the next pointers before the threads start. This pass is as slow as
+ * iterating the list without doing any work, so it only pays off when the
+ * function does more than a few pointer hops worth of work per node.
+ */
+#if LIST_HAS_THREADS_
+
+#ifndef LIST_PARALLEL_CHUNK
+#define LIST_PARALLEL_CHUNK 1024
+#endif
+
+/* Function called for every node or element with the context pointer */
+typedef void (*list_visit_t)(void *item, void *ctx);
+
+/* A thread of a parallel loop and the chunks it has left */
+struct list_worker_ {
+	pthread_mutex_t lock;
+	pthread_t thread;
+	size_t lo; // next chunk to run
+	size_t hi; // end of the chunks left
+	int id;
+	int started; // whether the thread was created
+	struct list_parallel_ *par;
+};
+
+struct list_parallel_ {
+	struct list_worker_ *workers;
+	int nworkers;
+	void (*run)(struct list_parallel_ *par, size_t chunk);
+	list_visit_t fn;
+	void *ctx;
+	void *items; // the list or the array
+	void **marks; // first node of every chunk of a list
+	size_t nchunks;
+	size_t len; // amount of elements of an array
+	size_t size; // next offset of a list, element size of an array
+	size_t per; // elements per chunk of an array
+};
+
+/* Takes the next chunk of worker W, or half of the chunks of another worker
+ *
+ * Returns 0 once there is nothing left anywhere.
+ */
+static inline int list_worker_take_(struct list_worker_ *w, size_t *chunk) {
+	struct list_worker_ *v;
+	size_t lo, hi;
+	int i;
+
+	pthread_mutex_lock(&w->lock);
+	if(w->lo < w->hi) {
+		*chunk = w->lo++;
+		pthread_mutex_unlock(&w->lock);
+		return 1;
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	for(i = 1; i < w->par->nworkers; i++) {
+		v = w->par->workers + (w->id + i) % w->par->nworkers;
+
+		pthread_mutex_lock(&v->lock);
+		hi = v->hi;
+		lo = v->hi - (v->hi - v->lo) / 2;
+		if(lo == hi && v->lo < v->hi) lo--;
+		v->hi = lo;
+		pthread_mutex_unlock(&v->lock);
+
+		if(lo < hi) {
+			*chunk = lo;
+			pthread_mutex_lock(&w->lock);
+			w->lo = lo + 1;
+			w->hi = hi;
+			pthread_mutex_unlock(&w->lock);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static inline void *list_worker_run_(void *arg) {
+	struct list_worker_ *w;
+	size_t chunk;
+
+	w = (struct list_worker_*) arg;
+	while(list_worker_take_(w, &chunk)) w->par->run(w->par, chunk);
+
+	return list_null_;
+}
+
+/* Runs all chunks of PAR on NTHREADS threads, including the calling one */
+static inline void list_parallel_run_(struct list_parallel_ *par,
+		int nthreads) {
+	struct list_worker_ *w;
+	size_t chunk;
+	int i;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	if(nthreads <= 0) nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if((size_t) nthreads > par->nchunks) nthreads = (int) par->nchunks;
+	if(nthreads <= 1) {
+		for(chunk = 0; chunk < par->nchunks; chunk++) par->run(par, chunk);
+		return;
+	}
+
+	par->workers = (struct list_worker_*) LIST_CALLOC(nthreads,
+			sizeof(struct list_worker_));
+	if(!par->workers) {
+		for(chunk = 0; chunk < par->nchunks; chunk++) par->run(par, chunk);
+		return;
+	}
+	par->nworkers = nthreads;
+
+	for(i = 0; i < nthreads; i++) {
+		w = par->workers + i;
+		pthread_mutex_init(&w->lock, list_null_);
+		w->lo = par->nchunks * i / nthreads;
+		w->hi = par->nchunks * (i + 1) / nthreads;
+		w->id = i;
+		w->par = par;
+	}
+
+	for(i = 1; i < nthreads; i++) {
+		w = par->workers + i;
+		w->started = pthread_create(&w->thread, list_null_,
+				list_worker_run_, w) == 0;
+	}
+	list_worker_run_(par->workers);
+
+	// the calling thread takes over the chunks of threads that didn't start
+	for(i = 1; i < nthreads; i++) {
+		w = par->workers + i;
+		if(!w->started) list_worker_run_(w);
+	}
+	for(i = 1; i < nthreads; i++) {
+		w = par->workers + i;
+		if(w->started) pthread_join(w->thread, list_null_);
+	}
+
+	for(i = 0; i < nthreads; i++) pthread_mutex_destroy(&par->workers[i].lock);
+	LIST_FREE(par->workers);
+}
+
+static inline void list_parallel_chunk_(struct list_parallel_ *par,
+		size_t chunk) {
+	void *node, *next, *end;
+
+	// the last chunk ends where the first one starts
+	end = chunk + 1 < par->nchunks ? par->marks[chunk + 1] : par->items;
+	node = par->marks[chunk];
+	do {
+		next = list_link_(node, par->size);
+		par->fn(node, par->ctx);
+		node = next;
+	} while(node != end);
+}
+
+static inline void list_parallel_foreach_(void *list, size_t off,
+		list_visit_t fn, void *ctx, int nthreads) {
+	struct list_parallel_ par;
+	void *node, *next;
+	size_t i;
+
+	if(!list) return;
+
+	memset(&par, 0, sizeof(par));
+	array_new(&par.marks, void*);
+	if(!par.marks) {
+		// out of memory, so go through the list on this thread
+		node = list;
+		do {
+			next = list_link_(node, off);
+			fn(node, ctx);
+			node = next;
+		} while(node != list);
+		return;
+	}
+
+	// mark the first node of every chunk
+	node = list;
+	i = 0;
+	do {
+		if(i++ % LIST_PARALLEL_CHUNK == 0) array_append(par.marks, node);
+		node = list_link_(node, off);
+	} while(node != list);
+
+	par.run = list_parallel_chunk_;
+	par.fn = fn;
+	par.ctx = ctx;
+	par.items = list;
+	par.nchunks = array_len(par.marks);
+	par.size = off;
+	list_parallel_run_(&par, nthreads);
+
+	array_free(par.marks);
+}
+
+static inline void array_parallel_chunk_(struct list_parallel_ *par,
+		size_t chunk) {
+	size_t i, end;
+
+	end = (chunk + 1) * par->per < par->len ? (chunk + 1) * par->per : par->len;
+	for(i = chunk * par->per; i < end; i++) {
+		par->fn((char*) par->items + i * par->size, par->ctx);
+	}
+}
+
+static inline void array_parallel_foreach_(void *a, size_t len, size_t esize,
+		list_visit_t fn, void *ctx, int nthreads) {
+	struct list_parallel_ par;
+
+	if(!len) return;
+
+	memset(&par, 0, sizeof(par));
+	par.run = array_parallel_chunk_;
+	par.fn = fn;
+	par.ctx = ctx;
+	par.items = a;
+	par.len = len;
+	par.size = esize;
+	par.per = LIST_PARALLEL_CHUNK;
+	par.nchunks = (len + par.per - 1) / par.per;
+	list_parallel_run_(&par, nthreads);
+}
+
+/* Call FN for every node of a list using NTHREADS threads
+ *
+ * FN is a list_visit_t, it gets a pointer to the node and CTX. NTHREADS
+ * includes the calling thread, 0 uses one thread for every CPU.
+ *
+ * Example:
+ * void visit(void *node, void *ctx) {
+ * 	((struct node*) node)->some_value *= 2;
+ * }
+ * list_parallel_foreach(&list, visit, NULL, 0);
+ */
+#define list_parallel_foreach(LIST, FN, CTX, NTHREADS) \
+	list_parallel_foreach_(*(LIST), \
+			*(LIST) ? list_offset_(*(LIST), next) : 0, \
+			(FN), (CTX), (NTHREADS))
+
+/* Call FN for every element of an array using NTHREADS threads
+ *
+ * FN gets a pointer to the element and CTX.
+ */
+#define array_parallel_foreach(A, FN, CTX, NTHREADS) \
+	array_parallel_foreach_((A), array_len(A), array_meta(A)->esize, \
+			(FN), (CTX), (NTHREADS))
+
+#endif
+
+/* Index lists
+ *
+ * slots: [ 0 ][ 1 ][ 2 ][ 3 ][ 4 ] ...  <- a dynamic array of nodes
+ *           |         ^    |
+ *           +- next --+    +- next -> ...
+ *
+ * Index lists are circular doubly linked lists whose nodes live in a dynamic
+ * array and reference each other by their index in that array instead of by
+ * pointer. The links only take 32 bits each, which halves the size of the links
+ * on 64-bit machines, and since no node contains a pointer, the whole array can
+ * be moved to a different place in memory (for example by a single realloc)
+ * without fixing anything up.
+ *
+ * These macros assume that the nodes have 32-bit /next/ and /prev/ elements:
+ * struct inode {
+ * 	uint32_t next;
+ * 	uint32_t prev;
+ * 	--SOME DATA--
+ * };
+ *
+ * A is the dynamic array containing the nodes, like /struct inode * /. Several
+ * lists can share the same array.
+ *
+ * LISTs are pointers to the index of the first node, like /uint32_t * /. Empty
+ * lists have the index ilist_null, so initializing a list means setting it to
+ * ilist_null.
+ *
+ * Nodes are indices into A. New nodes are taken from A with ilist_alloc, which
+ * reuses nodes given back with ilist_release before growing the array. The
+ * released nodes are kept in a separate singly linked free list, FREE is a
+ * pointer to its first index and starts out as ilist_null as well.
+ *
+ * Since ilist_null is an index too, an array holds at most 2^32 - 1 nodes.
+ * When all of them are in use ilist_alloc gives ilist_null.
+ *
+ * Example:
+ * struct inode *nodes;
+ * uint32_t list, free_nodes, i;
+ * array_new(&nodes, struct inode);
+ * list = ilist_null;
+ * free_nodes = ilist_null;
+ * ilist_alloc(nodes, &free_nodes, i);
+ * nodes[i].value = 42;
+ * ilist_append(nodes, &list, i);
+ * ilist_foreach(nodes, &list, i) {
+ * 	printf("%d\n", nodes[i].value);
+ * }
+ */
+
+/* Index of no node at all, the index list version of NULL */
+#define ilist_null ((uint32_t) 0xffffffff)
+
+/* Take a new node from the array
+ *
+ * Writes the index of the node to I. The node is zeroed. When no released node
+ * is left, the array grows by one node, so A might be moved. I is set to
+ * ilist_null instead if the array already holds the most nodes it can.
+ */
+#define ilist_alloc(A, FREE, I) {\
+	if(*(FREE) != ilist_null) {\
+		(I) = *(FREE);\
+		*(FREE) = (A)[I].next;\
+	}\
+	else if(array_len(A) < ilist_null) {\
+		array_reserve(A, array_len(A) + 1);\
+		(I) = (uint32_t) array_meta(A)->count++;\
+	}\
+	else {\
+		(I) = ilist_null;\
+	}\
+	if((I) != ilist_null) memset(&(A)[I], 0, array_meta(A)->esize);\
+}
+
+/* Give a node back so ilist_alloc can reuse it
+ *
+ * The node has to be removed from any list first.
+ */
+#define ilist_release(A, FREE, I) {\
+	(A)[I].next = *(FREE);\
+	*(FREE) = (I);\
+}
+
+/* Insert a node into the end of a list
+ */
+#define ilist_append(A, LIST, I) {\
+	if(*(LIST) == ilist_null) {\
+		*(LIST) = (I);\
+		(A)[I].next = (I);\
+		(A)[I].prev = (I);\
+	}\
+	else {\
+		(A)[I].next = *(LIST);\
+		(A)[I].prev = (A)[*(LIST)].prev;\
+		(A)[(A)[*(LIST)].prev].next = (I);\
+		(A)[*(LIST)].prev = (I);\
+	}\
+}
+
+/* Insert a node into the start of a list
+ */
+#define ilist_prepend(A, LIST, I) {\
+	ilist_append(A, LIST, I)\
+	*(LIST) = (I);\
+}
+
+/* Insert a node after another node
+ *
+ * Requirements:
+ * 	LIST has to have at least one node
+ * 	AFTER has to be in LIST
+ */
+#define ilist_insert_after(A, LIST, I, AFTER) {\
+	(A)[I].prev = (AFTER);\
+	(A)[I].next = (A)[AFTER].next;\
+	(A)[(A)[AFTER].next].prev = (I);\
+	(A)[AFTER].next = (I);\
+}
+
+/* Insert a node before another node
+ *
+ * Requirements:
+ * 	LIST has to have at least one node
+ * 	BEFORE has to be in LIST
+ */
+#define ilist_insert_before(A, LIST, I, BEFORE) {\
+	(A)[I].prev = (A)[BEFORE].prev;\
+	(A)[I].next = (BEFORE);\
+	(A)[(A)[BEFORE].prev].next = (I);\
+	(A)[BEFORE].prev = (I);\
+	if((BEFORE) == *(LIST)) *(LIST) = (I);\
+}
+
+/* Remove a node from a list
+ *
+ * The node stays in A, give it back with ilist_release to reuse it.
+ */
+#define ilist_remove(A, LIST, I) {\
+	if(*(LIST) == (I)) *(LIST) = (A)[I].next;\
+	if(*(LIST) == (I)) *(LIST) = ilist_null;\
+	else {\
+		(A)[(A)[I].next].prev = (A)[I].prev;\
+		(A)[(A)[I].prev].next = (A)[I].next;\
+	}\
+}
+
+/* Check whether a list is empty or not
+ */
+#define ilist_is_empty(LIST) (*(LIST) == ilist_null)
+
+/* Iterate through each node in the list
+ *
+ * I is the index of the current node.
+ */
+#define ilist_foreach(A, LIST, I) for((I) = *(LIST);\
+		(I) != ilist_null;\
+		(I) = ((A)[I].next == *(LIST) ? ilist_null : (A)[I].next))
+
+/* Iterate through each node in the list in reverse order
+ */
+#define ilist_foreach_reverse(A, LIST, I) \
+	for((I) = *(LIST) != ilist_null ? (A)[*(LIST)].prev : ilist_null;\
+		(I) != ilist_null;\
+		(I) = ((I) == *(LIST) ? ilist_null : (A)[I].prev))
+
+/* Iterate through each node in the list safely
+ *
+ * Like ilist_foreach but nodes can be removed safely. TMP is another index.
+ */
+#define ilist_foreach_safe(A, LIST, I, TMP) for((I) = *(LIST);\
+		(I) != ilist_null && (\
+		((TMP) = (A)[I].next == *(LIST) ? ilist_null : (A)[I].next)\
+		|| 1);\
+		(I) = (TMP))
+
+/* Iterate in reverse order through each node in the list safely
+ */
+#define ilist_foreach_reverse_safe(A, LIST, I, TMP) \
+	for((I) = *(LIST) != ilist_null ? (A)[*(LIST)].prev : ilist_null;\
+		(I) != ilist_null && (\
+		((TMP) = (A)[I].prev == (A)[*(LIST)].prev ? \
+		ilist_null : (A)[I].prev)\
+		|| 1);\
+		(I) = (TMP))
+
+/* Type specialized functions
+ *
+ * The macros above evaluate their arguments several times and read the head of
+ * the list through the LIST pointer on every step. Since any store through a
+ * node pointer might change that head, the compiler has to load it again and
+ * again, and arguments with side effects are evaluated more than once.
+ *
+ * LIST_DEFINE(P, T) and ARRAY_DEFINE(P, T) generate static inline functions
+ * prefixed with P for lists with nodes of type T and arrays with elements of
+ * type T. Every argument of these functions is evaluated exactly once and the
+ * head of the list (or the array pointer) is kept in a local variable for the
+ * whole operation, so it can live in a register. The functions are built from
+ * the same macros, so both always behave the same way.
+ *
+ * LIST_DEFINE generates:
+ * 	P_append(T **list, T *node)
+ * 	P_prepend(T **list, T *node)
+ * 	P_insert_after(T **list, T *node, T *after)
+ * 	P_insert_before(T **list, T *node, T *before)
+ * 	P_remove(T **list, T *node)
+ * 	P_is_empty(T *list)
+ * 	P_first(T *list), P_last(T *list)
+ * 	P_next(T *list, T *node), P_prev(T *list, T *node)
+ *
+ * The iteration functions take the head of the list by value and return NULL
+ * once the iteration wraps around, like list_foreach and list_foreach_reverse.
+ *
+ * Example:
+ * LIST_DEFINE(node, struct node)
+ *
+ * struct node *list, *n;
+ * node_append(&list, create_node());
+ * for(n = node_first(list); n; n = node_next(list, n)) {
+ * 	printf("%d\n", n->some_value);
+ * }
+ */
+#define LIST_DEFINE(P, T) \
+static inline void P##_append(T **list, T *node) {\
+	T *head = *list;\
+	list_append(&head, node);\
+	*list = head;\
+}\
+static inline void P##_prepend(T **list, T *node) {\
+	T *head = *list;\
+	list_prepend(&head, node);\
+	*list = head;\
+}\
+static inline void P##_insert_after(T **list, T *node, T *after) {\
+	(void) list;\
+	list_insert_after(list, node, after);\
+}\
+static inline void P##_insert_before(T **list, T *node, T *before) {\
+	T *head = *list;\
+	list_insert_before(&head, node, before);\
+	*list = head;\
+}\
+static inline void P##_remove(T **list, T *node) {\
+	T *head = *list;\
+	list_remove(&head, node);\
+	*list = head;\
+}\
+static inline int P##_is_empty(T *list) {\
+	return list == list_null_;\
+}\
+static inline T *P##_first(T *list) {\
+	return list;\
+}\
+static inline T *P##_last(T *list) {\
+	return list ? list->prev : list_null_;\
+}\
+static inline T *P##_next(T *list, T *node) {\
+	return node->next == list ? list_null_ : node->next;\
+}\
+static inline T *P##_prev(T *list, T *node) {\
+	return node == list ? list_null_ : node->prev;\
+}
+
+/* ARRAY_DEFINE generates:
+ * 	T *P_new(void)
+ * 	P_free(T *a)
+ * 	size_t P_len(T *a)
+ * 	P_reserve(T **a, size_t r)
+ * 	P_append(T **a, T e)
+ * 	P_extend(T **a, const T *src, size_t n)
+ * 	P_insert_n(T **a, size_t idx, const T *src, size_t n)
+ *
+ * Functions that might grow the array take a pointer to the array pointer.
+ *
+ * Example:
+ * ARRAY_DEFINE(ints, int)
+ *
+ * int *values;
+ * values = ints_new();
+ * ints_append(&values, 42);
+ * ints_free(values);
+ */
+#define ARRAY_DEFINE(P, T) \
+static inline T *P##_new(void) {\
+	T *a;\
+	array_new(&a, T);\
+	return a;\
+}\
+static inline void P##_free(T *a) {\
+	array_free(a);\
+}\
+static inline size_t P##_len(T *a) {\
+	return array_len(a);\
+}\
+static inline void P##_reserve(T **ap, size_t r) {\
+	T *a = *ap;\
+	array_reserve(a, r);\
+	*ap = a;\
+}\
+static inline void P##_append(T **ap, T e) {\
+	T *a = *ap;\
+	array_append(a, e);\
+	*ap = a;\
+}\
+static inline void P##_extend(T **ap, const T *src, size_t n) {\
+	T *a = *ap;\
+	array_extend(a, src, n);\
+	*ap = a;\
+}\
+static inline void P##_insert_n(T **ap, size_t idx, const T *src,\
+		size_t n) {\
+	T *a = *ap;\
+	array_insert_n(a, idx, src, n);\
+	*ap = a;\
+}
+
+/* Heaps
+ *
+ * A heap is a dynamic array ordered as a tree in which every element comes
+ * before its children, so the first element is always the smallest one and
+ * adding or taking elements costs O(log n).
+ *
+ * HEAP_DEFINE(P, T, CMP, D) defines these functions for heaps of elements of
+ * type T compared by CMP, a function or macro comparing two pointers to
+ * elements like the function passed to list_sort:
+ * 	void P_push(T **h, T e)
+ * 	T P_pop(T **h)
+ * 	T P_top(T *h)
+ * 	void P_heapify(T *h)
+ * 	void P_decrease_key(T *h, size_t idx, T e)
+ * 	size_t P_len(T *h)
+ *
+ * D is the amount of children of every element, either 2 or 4. With 4 the
+ * tree is half as deep and the children of an element share a cache line when
+ * the elements are small, which makes taking elements cheaper.
+ *
+ * The heap is created with array_new and freed with array_free. P_heapify turns
+ * an array with elements in any order into a heap in O(n). P_pop and P_top must
+ * not be used on an empty heap.
+ *
+ * P_decrease_key replaces the element at IDX with E, which must not compare
+ * greater than the element it replaces. To know the index of an element, use
+ * HEAP_DEFINE_TRACKED(P, T, CMP, D, MOVED) instead. It calls MOVED(T *e,
+ * size_t idx) every time an element is placed at index IDX of the heap.
+ *
+ * Example:
+ * HEAP_DEFINE(ints_heap, int, cmp_int, 4)
+ *
+ * int *heap;
+ * array_new(&heap, int);
+ * ints_heap_push(&heap, 42);
+ * printf("%d\n", ints_heap_pop(&heap));
+ * array_free(heap);
+ */
+#define heap_untracked_(E, IDX)
+
+#define HEAP_DEFINE(P, T, CMP, D) \
+	HEAP_DEFINE_TRACKED(P, T, CMP, D, heap_untracked_)
+
+#define HEAP_DEFINE_TRACKED(P, T, CMP, D, MOVED) \
+typedef char P##_arity_check_[(D) == 2 || (D) == 4 ? 1 : -1];\
+/* Moves E from index I towards the top until its parent is smaller */\
+static inline void P##_up_(T *h, size_t i, T e) {\
+	size_t parent;\
+	while(i > 0) {\
+		parent = (i - 1) / (D);\
+		if(CMP(&e, &h[parent]) >= 0) break;\
+		h[i] = h[parent];\
+		MOVED(&h[i], i);\
+		i = parent;\
+	}\
+	h[i] = e;\
+	MOVED(&h[i], i);\
+}\
+/* Moves E from index I towards the bottom until its children are larger */\
+static inline void P##_down_(T *h, size_t i, T e, size_t n) {\
+	size_t c, k, best;\
+	while((c = (D) * i + 1) < n) {\
+		for(k = c + 1, best = c; k < c + (D) && k < n; k++) {\
+			if(CMP(&h[k], &h[best]) < 0) best = k;\
+		}\
+		if(CMP(&h[best], &e) >= 0) break;\
+		h[i] = h[best];\
+		MOVED(&h[i], i);\
+		i = best;\
+	}\
+	h[i] = e;\
+	MOVED(&h[i], i);\
+}\
+static inline void P##_push(T **hp, T e) {\
+	T *h = *hp;\
+	array_reserve(h, array_len(h) + 1);\
+	array_meta(h)->count++;\
+	P##_up_(h, array_len(h) - 1, e);\
+	*hp = h;\
+}\
+static inline T P##_pop(T **hp) {\
+	T *h = *hp, top;\
+	size_t n;\
+	top = h[0];\
+	n = --array_meta(h)->count;\
+	if(n) P##_down_(h, 0, h[n], n);\
+	return top;\
+}\
+static inline T P##_top(T *h) {\
+	return h[0];\
+}\
+static inline void P##_heapify(T *h) {\
+	size_t i, n;\
+	n = array_len(h);\
+	for(i = n > 1 ? (n - 2) / (D) + 1 : 0; i-- > 0;) P##_down_(h, i, h[i], n);\
+	for(i = 0; i < n; i++) {\
+		MOVED(&h[i], i);\
+	}\
+}\
+static inline void P##_decrease_key(T *h, size_t idx, T e) {\
+	P##_up_(h, idx, e);\
+}\
+static inline size_t P##_len(T *h) {\
+	return array_len(h);\
+}
+
+/* Unrolled lists
+ *
+ *  +-------------------------------------------------------------------+
+ *  |                                                                   |
+ *  |    +--------A--------+      +--------B--------+                   |
+ *  +--> |             next| ---> |             next| ---> ...  --------+
+ *       | count = 3       |      | count = 2       |
+ *       | [e0][e1][e2][  ]|      | [e3][e4][  ][  ]|
+ *  +--- |prev             | <--- |prev             | <--- ...  <-------+
+ *  |    +-----------------+      +-----------------+                   |
+ *  |                                                                   |
+ *  +-------------------------------------------------------------------+
+ *
+ * An unrolled list is a circular doubly linked list whose nodes hold a small
+ * array of elements instead of a single one. This cuts the amount of pointers
+ * and allocations per element and most steps of an iteration stay inside the
+ * array of a node, so iterating gets close to the speed of a plain array, while
+ * inserting in the middle still only moves the elements of a single node.
+ *
+ * UNROLLED_DEFINE(P, T, N) defines /struct P/ for elements of type T with room
+ * for N elements per node, plus these functions (N has to be at least 2):
+ * 	int P_append(struct P **list, T e)
+ * 	int P_prepend(struct P **list, T e)
+ * 	int P_insert(struct P **list, struct P *node, int idx, T e)
+ * 	void P_remove(struct P **list, struct P *node, int idx)
+ * 	void P_erase(struct P **list, struct P **node, int *idx)
+ * 	void P_erase_reverse(struct P **list, struct P **node, int *idx)
+ * 	long P_len(struct P *list)
+ * 	void P_free(struct P **list)
+ *
+ * The functions that insert elements return -1 when they are out of memory and
+ * 0 otherwise. P_insert inserts E in front of the element at index IDX of NODE,
+ * IDX may be equal to the amount of elements in NODE.
+ *
+ * A full node is split in half when an element is inserted into it. When
+ * removing an element leaves a node empty, the node is freed, and when a node
+ * and its neighbour fit into half a node together they are merged.
+ *
+ * The nodes are regular list nodes, so all the list macros work on them.
+ * unrolled_capacity(T) gives a good value for N.
+ *
+ * Example:
+ * UNROLLED_DEFINE(ints, int, unrolled_capacity(int))
+ *
+ * struct ints *list, *node;
+ * int i;
+ * list = NULL;
+ * ints_append(&list, 42);
+ * unrolled_foreach(&list, node, i) {
+ * 	printf("%d\n", node->items[i]);
+ * }
+ * ints_free(&list);
+ */
+
+/* Amount of elements of type T that fit into a node of 128 bytes
+ *
+ * Nodes need room for at least two elements so they can be split, so this never
+ * goes below 2.
+ */
+#define unrolled_capacity(T) \
+	((int) ((128 - 2 * sizeof(void*) - sizeof(int)) / sizeof(T) >= 2 ? \
+	 (128 - 2 * sizeof(void*) - sizeof(int)) / sizeof(T) : 2))
+
+/* Iterate through each element of an unrolled list
+ *
+ * NODE is the node containing the current element and I its index, so the
+ * element itself is /NODE->items[I]/.
+ *
+ * Note that this is made of two nested loops, so break only leaves the inner
+ * one. Use goto or the safe version to stop early.
+ */
+#define unrolled_foreach(LIST, NODE, I) list_foreach(LIST, NODE)\
+	for((I) = 0; (I) < (NODE)->count; (I)++)
+
+/* Iterate through each element of an unrolled list in reverse order
+ */
+#define unrolled_foreach_reverse(LIST, NODE, I) list_foreach_reverse(LIST, NODE)\
+	for((I) = (NODE)->count - 1; (I) >= 0; (I)--)
+
+/* Iterate through each element of an unrolled list safely
+ *
+ * Like unrolled_foreach but the current element can be removed by calling
+ * P_erase(LIST, &NODE, &I). P_erase moves NODE and I so that the loop
+ * continues with the element after the removed one, even when nodes were
+ * merged or freed. This is a single loop, so break works as usual.
+ */
+#define unrolled_foreach_safe(LIST, NODE, I) \
+	for((NODE) = *(LIST), (I) = 0;\
+		(NODE);\
+		(NODE) = !(NODE) || ++(I) < (NODE)->count ? (NODE) :\
+		((I) = 0, (NODE)->next == *(LIST) ? list_null_ : (NODE)->next))
+
+/* Iterate in reverse order through each element of an unrolled list safely
+ *
+ * Like unrolled_foreach_safe but the current element has to be removed with
+ * P_erase_reverse(LIST, &NODE, &I) instead.
+ */
+#define unrolled_foreach_reverse_safe(LIST, NODE, I) \
+	for((NODE) = *(LIST) ? (*(LIST))->prev : list_null_,\
+		(I) = (NODE) ? (NODE)->count - 1 : 0;\
+		(NODE);\
+		(NODE) = !(NODE) || --(I) >= 0 ? (NODE) :\
+		((NODE) == *(LIST) ? list_null_ :\
+		 ((I) = (NODE)->prev->count - 1, (NODE)->prev)))
+
+#define UNROLLED_DEFINE(P, T, N) \
+struct P {\
+	struct P *next;\
+	struct P *prev;\
+	int count;\
+	T items[N];\
+};\
+typedef char P##_capacity_check_[(N) >= 2 ? 1 : -1];\
+static inline struct P *P##_node_(void) {\
+	return (struct P*) LIST_CALLOC(1, sizeof(struct P));\
+}\
+static inline int P##_insert(struct P **list, struct P *node, int idx, T e) {\
+	struct P *half;\
+	(void) list;\
+	if(node->count == (N)) {\
+		half = P##_node_();\
+		if(!half) return -1;\
+		half->count = (N) - (N) / 2;\
+		memcpy(half->items, node->items + (N) / 2, half->count * sizeof(T));\
+		node->count = (N) / 2;\
+		list_insert_after(list, half, node);\
+		if(idx > node->count) {\
+			idx -= node->count;\
+			node = half;\
+		}\
+	}\
+	memmove(node->items + idx + 1, node->items + idx,\
+			(node->count - idx) * sizeof(T));\
+	node->items[idx] = e;\
+	node->count++;\
+	return 0;\
+}\
+static inline int P##_append(struct P **list, T e) {\
+	struct P *node;\
+	if(!*list || (*list)->prev->count == (N)) {\
+		node = P##_node_();\
+		if(!node) return -1;\
+		list_append(list, node);\
+	}\
+	node = (*list)->prev;\
+	node->items[node->count++] = e;\
+	return 0;\
+}\
+static inline int P##_prepend(struct P **list, T e) {\
+	struct P *node;\
+	if(!*list || (*list)->count == (N)) {\
+		node = P##_node_();\
+		if(!node) return -1;\
+		list_prepend(list, node);\
+	}\
+	return P##_insert(list, *list, 0, e);\
+}\
+static inline void P##_erase_(struct P **list, struct P **node, int *idx,\
+		int reverse) {\
+	struct P *n, *a, *b, *succ;\
+	int i;\
+	n = *node;\
+	i = *idx;\
+	n->count--;\
+	memmove(n->items + i, n->items + i + 1, (n->count - i) * sizeof(T));\
+	/* find the element following the removed one */\
+	succ = n;\
+	if(i == n->count) {\
+		succ = n->next == *list ? list_null_ : n->next;\
+		i = 0;\
+	}\
+	if(n->count == 0) {\
+		list_remove(list, n);\
+		LIST_FREE(n);\
+	}\
+	else if(n->next != n) {\
+		a = n->next == *list ? n->prev : n;\
+		b = a->next;\
+		if(a->count + b->count <= (N) / 2) {\
+			memcpy(a->items + a->count, b->items, b->count * sizeof(T));\
+			if(succ == b) {\
+				succ = a;\
+				i += a->count;\
+			}\
+			a->count += b->count;\
+			list_remove(list, b);\
+			LIST_FREE(b);\
+		}\
+	}\
+	/* move the iterator so the next step lands on the successor */\
+	if(!*list) {\
+		*node = list_null_;\
+		*idx = 0;\
+	}\
+	else if(!succ) {\
+		*node = (*list)->prev;\
+		*idx = (*node)->count - !reverse;\
+	}\
+	else {\
+		*node = succ;\
+		*idx = i - !reverse;\
+	}\
+}\
+static inline void P##_erase(struct P **list, struct P **node, int *idx) {\
+	P##_erase_(list, node, idx, 0);\
+}\
+static inline void P##_erase_reverse(struct P **list, struct P **node,\
+		int *idx) {\
+	P##_erase_(list, node, idx, 1);\
+}\
+static inline void P##_remove(struct P **list, struct P *node, int idx) {\
+	P##_erase_(list, &node, &idx, 0);\
+}\
+static inline long P##_len(struct P *list) {\
+	long len;\
+	struct P *node;\
+	len = 0;\
+	list_foreach(&list, node) len += node->count;\
+	return len;\
+}\
+static inline void P##_free(struct P **list) {\
+	struct P *node, *tmp;\
+	list_foreach_safe(list, node, tmp) LIST_FREE(node);\
+	*list = list_null_;\
+}
+
+
+/* Skip lists
+ *
+ *  level 1:  A ----------------> C ----------------> NULL
+ *  level 0:  A <-> B <-> C <-> D <-> E  (circular)
+ *
+ * A skip list keeps its nodes sorted and finds, inserts and removes nodes in
+ * O(log n) expected time. Level 0 is a regular circular doubly linked list of
+ * all nodes in order, so list_foreach, list_foreach_reverse and the other list
+ * macros that don't change the list work on /s.list/. Some of the nodes are
+ * also part of the levels above, which are singly linked lists skipping
+ * more and more nodes.
+ *
+ * On top of /next/ and /prev/ the nodes need an array of pointers called
+ * /skip/ for the levels above the list:
+ * struct node {
+ * 	struct node *next;
+ * 	struct node *prev;
+ * 	struct node *skip[8];
+ * 	--SOME DATA--
+ * };
+ *
+ * Each level holds about a quarter of the nodes of the level below, so N
+ * levels above the list keep operations fast up to about 4^(N+1) nodes.
+ *
+ * SKIPLIST_DEFINE(P, T, CMP) defines /struct P/ for nodes of type T sorted by
+ * CMP, which compares two nodes like the function passed to list_sort, plus
+ * these functions:
+ * 	void P_insert(struct P *s, T *node)
+ * 	void P_remove(struct P *s, T *node)
+ * 	T *P_lower_bound(struct P *s, const T *key)
+ * 	T *P_find(struct P *s, const T *key)
+ * 	size_t P_len(struct P *s)
+ *
+ * A zeroed /struct P/ is an empty skip list. Nodes comparing equal are kept in
+ * the order they were inserted. P_lower_bound returns the first node that does
+ * not compare less than KEY, P_find the first node comparing equal to KEY, or
+ * NULL if there is none. KEY is a node that only needs the fields CMP looks
+ * at.
+ *
+ * Example iterating over all nodes from 10 to 20:
+ * SKIPLIST_DEFINE(nodes, struct node, cmp_value)
+ * struct nodes s = {0};
+ * struct node key, *node;
+ * key.value = 10;
+ * list_foreach_from(&s.list, node, nodes_lower_bound(&s, &key)) {
+ * 	if(node->value > 20) break;
+ * 	printf("%d\n", node->value);
+ * }
+ */
+#define skiplist_levels_(T) (sizeof(((T*) 0)->skip) / sizeof(T*))
+
+#define SKIPLIST_DEFINE(P, T, CMP) \
+struct P {\
+	T *list;\
+	T *top[skiplist_levels_(T)];\
+	size_t len;\
+	uint64_t seed;\
+};\
+/* Height of a new node, a quarter of the nodes go up another level */\
+static inline size_t P##_height_(struct P *s) {\
+	uint64_t r;\
+	size_t h;\
+	if(!s->seed) s->seed = 0x9e3779b97f4a7c15ULL;\
+	s->seed ^= s->seed << 13;\
+	s->seed ^= s->seed >> 7;\
+	s->seed ^= s->seed << 17;\
+	for(r = s->seed, h = 0; h < skiplist_levels_(T) && !(r & 3); r >>= 2) h++;\
+	return h;\
+}\
+/* Last node of every level comparing less than KEY, or not more with AFTER */\
+static inline T *P##_search_(struct P *s, const T *key, int after, \
+		T **update) {\
+	T *x, *next;\
+	size_t i;\
+	x = list_null_;\
+	for(i = skiplist_levels_(T); i-- > 0;) {\
+		next = x ? x->skip[i] : s->top[i];\
+		while(next && CMP(next, key) < after) {\
+			x = next;\
+			next = x->skip[i];\
+		}\
+		update[i] = x;\
+	}\
+	next = x ? (x->next == s->list ? list_null_ : x->next) : s->list;\
+	while(next && CMP(next, key) < after) {\
+		x = next;\
+		next = x->next == s->list ? list_null_ : x->next;\
+	}\
+	return x;\
+}\
+static inline void P##_insert(struct P *s, T *node) {\
+	T *update[skiplist_levels_(T)], *x;\
+	size_t i, h;\
+	x = P##_search_(s, node, 1, update);\
+	if(x) {\
+		list_insert_after(&s->list, node, x);\
+	}\
+	else {\
+		list_prepend(&s->list, node);\
+	}\
+	for(i = 0, h = P##_height_(s); i < h; i++) {\
+		if(update[i]) {\
+			node->skip[i] = update[i]->skip[i];\
+			update[i]->skip[i] = node;\
+		}\
+		else {\
+			node->skip[i] = s->top[i];\
+			s->top[i] = node;\
+		}\
+	}\
+	s->len++;\
+}\
+static inline void P##_remove(struct P *s, T *node) {\
+	T *update[skiplist_levels_(T)], **link;\
+	size_t i;\
+	P##_search_(s, node, 0, update);\
+	/* NODE is somewhere among the nodes comparing equal on every level */\
+	for(i = 0; i < skiplist_levels_(T); i++) {\
+		link = update[i] ? &update[i]->skip[i] : &s->top[i];\
+		while(*link && *link != node && CMP(*link, node) == 0) {\
+			link = &(*link)->skip[i];\
+		}\
+		if(*link == node) *link = node->skip[i];\
+	}\
+	list_remove(&s->list, node);\
+	s->len--;\
+}\
+static inline T *P##_lower_bound(struct P *s, const T *key) {\
+	T *update[skiplist_levels_(T)], *x;\
+	x = P##_search_(s, key, 0, update);\
+	if(!x) return s->list;\
+	return x->next == s->list ? list_null_ : x->next;\
+}\
+static inline T *P##_find(struct P *s, const T *key) {\
+	T *node;\
+	node = P##_lower_bound(s, key);\
+	return node && CMP(node, key) == 0 ? node : list_null_;\
+}\
+static inline size_t P##_len(struct P *s) {\
+	return s->len;\
+}
+
+
+/* LRU caches
+ *
+ *  list:   A <-> B <-> C <-> D  (circular, most recently used first)
+ *  slots:  [ C ][   ][ A ][ D ][   ][ B ][   ][   ]
+ *
+ * An LRU cache holds up to a fixed amount of nodes and drops the least
+ * recently used one when a new node doesn't fit anymore. The nodes are kept
+ * in a circular doubly linked list from the most to the least recently used
+ * one, so the node to drop is always /list->prev/. To look nodes up by their
+ * key, pointers to them are also stored in a dynamic array of slots with
+ * linear probing that is never more than half full.
+ *
+ * LRU_DEFINE(P, T, HASH, EQ) defines /struct P/ for nodes of type T, which
+ * only need /next/ and /prev/, plus these functions:
+ * 	void P_init(struct P *c, size_t capacity)
+ * 	void P_free(struct P *c)
+ * 	T *P_get(struct P *c, const T *key)
+ * 	T *P_put(struct P *c, T *node)
+ * 	void P_touch(struct P *c, T *node)
+ * 	T *P_evict(struct P *c)
+ * 	void P_remove(struct P *c, T *node)
+ * 	size_t P_len(struct P *c)
+ *
+ * HASH(const T *node) returns an integer hash of the key of a node and
+ * EQ(const T *a, const T *b) is non-zero if both nodes have the same key. The
+ * slot of a node is picked with the lowest bits of the hash, so integer keys
+ * should be passed through lru_hash first. Like with skip lists, KEY is a node
+ * that only needs the fields HASH and EQ look at.
+ *
+ * All of these take O(1) time and only P_init and P_free allocate or free
+ * memory. The cache never owns the nodes: P_put returns the node that was
+ * replaced because it had the same key, or the node evicted to make room, or
+ * NULL, and the caller is free to reuse or free it. P_get moves the node it
+ * finds to the front of the list, P_touch does the same for a node that is
+ * already in the cache. P_free frees the slots but not the nodes.
+ *
+ * The counters /hits/ and /misses/ count the calls to P_get that found a node
+ * or not and /evictions/ counts the nodes dropped by P_put and P_evict.
+ *
+ * Example:
+ * LRU_DEFINE(entries, struct entry, hash_entry, eq_entry)
+ * struct entries c;
+ * struct entry key, *entry;
+ * entries_init(&c, 1000);
+ * key.id = 42;
+ * if(!(entry = entries_get(&c, &key))) {
+ * 	entry = load_entry(42);
+ * 	free(entries_put(&c, entry));
+ * }
+ */
+static inline uint64_t lru_hash(uint64_t x) {
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+#define LRU_DEFINE(P, T, HASH, EQ) \
+struct P {\
+	T *list;\
+	T **slots;\
+	size_t len;\
+	size_t capacity;\
+	uint64_t hits;\
+	uint64_t misses;\
+	uint64_t evictions;\
+};\
+static inline void P##_init(struct P *c, size_t capacity) {\
+	size_t n;\
+	for(n = 8; n < 2 * capacity; n *= 2);\
+	c->list = list_null_;\
+	array_new(&c->slots, T*);\
+	array_append_n(c->slots, (T*) list_null_, n);\
+	c->len = 0;\
+	c->capacity = capacity;\
+	c->hits = c->misses = c->evictions = 0;\
+}\
+static inline void P##_free(struct P *c) {\
+	array_free(c->slots);\
+}\
+/* Slot of the node with the same key as KEY, or the empty slot ending the run */\
+static inline size_t P##_slot_(struct P *c, const T *key) {\
+	size_t mask, i;\
+	mask = array_len(c->slots) - 1;\
+	for(i = (size_t) HASH(key) & mask; c->slots[i]; i = (i + 1) & mask) {\
+		if(EQ(c->slots[i], key)) break;\
+	}\
+	return i;\
+}\
+/* Empties slot I and moves nodes further along the run back into the gap */\
+static inline void P##_unslot_(struct P *c, size_t i) {\
+	size_t mask, j, home;\
+	mask = array_len(c->slots) - 1;\
+	for(j = (i + 1) & mask; c->slots[j]; j = (j + 1) & mask) {\
+		home = (size_t) HASH(c->slots[j]) & mask;\
+		if(((j - home) & mask) >= ((j - i) & mask)) {\
+			c->slots[i] = c->slots[j];\
+			i = j;\
+		}\
+	}\
+	c->slots[i] = list_null_;\
+}\
+static inline void P##_touch(struct P *c, T *node) {\
+	if(node == c->list) return;\
+	/* the last node becomes the first one by just moving the head */\
+	if(node != c->list->prev) {\
+		list_remove(&c->list, node);\
+		list_append(&c->list, node);\
+	}\
+	c->list = node;\
+}\
+static inline T *P##_get(struct P *c, const T *key) {\
+	T *node;\
+	node = c->slots[P##_slot_(c, key)];\
+	if(!node) {\
+		c->misses++;\
+		return list_null_;\
+	}\
+	c->hits++;\
+	P##_touch(c, node);\
+	return node;\
+}\
+static inline void P##_remove(struct P *c, T *node) {\
+	P##_unslot_(c, P##_slot_(c, node));\
+	list_remove(&c->list, node);\
+	c->len--;\
+}\
+static inline T *P##_evict(struct P *c) {\
+	T *node;\
+	if(!c->list) return list_null_;\
+	node = c->list->prev;\
+	P##_remove(c, node);\
+	c->evictions++;\
+	return node;\
+}\
+static inline T *P##_put(struct P *c, T *node) {\
+	T *old;\
+	size_t i;\
+	i = P##_slot_(c, node);\
+	old = c->slots[i];\
+	if(old == node) {\
+		P##_touch(c, node);\
+		return list_null_;\
+	}\
+	c->slots[i] = node;\
+	if(old) {\
+		list_remove(&c->list, old);\
+		list_prepend(&c->list, node);\
+		return old;\
+	}\
+	list_prepend(&c->list, node);\
+	if(++c->len > c->capacity) return P##_evict(c);\
+	return list_null_;\
+}\
+static inline size_t P##_len(struct P *c) {\
+	return c->len;\
+}
+
+
+/* Timer wheels
+ *
+ *  level 1:  [  ][  ][##][  ] ...  64 slots of 64 ticks each
+ *  level 0:  [  ][##][  ][##] ...  64 slots of 1 tick each
+ *                  ^
+ *                  now
+ *
+ * A timer wheel keeps timers in slots by the tick they expire at. Every slot
+ * is a circular doubly linked list, so scheduling and cancelling a timer only
+ * takes a constant amount of pointer updates, and all timers of a slot expire
+ * at once by appending the whole slot to a list.
+ *
+ * The wheel has TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS slots, each
+ * level covering 64 times as many ticks per slot as the one below. Timers
+ * expiring in the next 64 ticks are in level 0, later ones in the levels
+ * above and when a slot of a higher level comes up its timers are moved down
+ * into the lower levels. Timers even further in the future than the top level
+ * reaches are put into the top level and looked at again each time their slot
+ * comes up.
+ *
+ * On top of /next/ and /prev/ the timers need the tick they expire at:
+ * struct timer {
+ * 	struct timer *next;
+ * 	struct timer *prev;
+ * 	uint64_t expires;
+ * 	--SOME DATA--
+ * };
+ *
+ * TIMER_WHEEL_DEFINE(P, T) defines /struct P/ for timers of type T plus these
+ * functions:
+ * 	void P_init(struct P *w, uint64_t now)
+ * 	void P_free(struct P *w)
+ * 	void P_schedule(struct P *w, T *timer, uint64_t expires)
+ * 	int P_cancel(struct P *w, T *timer)
+ * 	void P_advance(struct P *w, uint64_t now, T **expired)
+ * 	int P_is_empty(struct P *w)
+ *
+ * P_advance moves the wheel to the tick NOW and appends all timers expiring
+ * at NOW or earlier to the list EXPIRED, in the order they expire. They are no
+ * longer part of the wheel. Empty stretches of the wheel are skipped, so
+ * advancing far at once is cheap. A timer scheduled for a tick that has
+ * already passed expires on the next call to P_advance. /w.now/ is the first
+ * tick the wheel hasn't processed yet.
+ *
+ * P_cancel takes a pending timer out of the wheel and returns 1. Timers that
+ * have already expired, were cancelled before or were never scheduled are
+ * left alone and give 0, so timers can be cancelled without keeping track of
+ * whether they are still pending. For the last case the timer has to start
+ * out zeroed, P_cancel tells by the /next/ pointer being NULL, which it also
+ * sets when cancelling. Expired timers are told by having an expiry before
+ * /w.now/, which pending timers never have.
+ *
+ * Example:
+ * TIMER_WHEEL_DEFINE(timers, struct timer)
+ * struct timers w;
+ * struct timer *expired = NULL, *timer, *tmp;
+ * timers_init(&w, ticks());
+ * timers_schedule(&w, &conn->timeout, ticks() + 5000);
+ * timers_advance(&w, ticks(), &expired);
+ * list_foreach_safe(&expired, timer, tmp) {
+ * 	list_remove(&expired, timer);
+ * 	handle_timeout(timer);
+ * }
+ */
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+static inline unsigned timer_wheel_ctz_(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll(x);
+#else
+	unsigned n;
+
+	for(n = 0; !(x & 1); x >>= 1) n++;
+
+	return n;
+#endif
+}
+
+/* Slot of a timer expiring at E, which must not be before NOW
+ *
+ * The level is the highest group of bits in which E and NOW differ, the top
+ * level taking everything that's further away.
+ */
+static inline size_t timer_wheel_slot_(uint64_t e, uint64_t now) {
+	uint64_t diff;
+	size_t l;
+
+	diff = e ^ now;
+	for(l = 0; l < TIMER_WHEEL_LEVELS - 1; l++) {
+		if(!(diff >> (TIMER_WHEEL_BITS * (l + 1)))) break;
+	}
+
+	return l * TIMER_WHEEL_SLOTS +
+		((e >> (TIMER_WHEEL_BITS * l)) & (TIMER_WHEEL_SLOTS - 1));
+}
+
+/* Finds the first tick from NOW on at which a slot has to be expired or moved
+ * down, returns 0 if all slots are empty
+ *
+ * Slots of level 0 come up at their tick, those of the levels above at the
+ * first tick they cover. A lower level always comes up before a higher one.
+ */
+static inline int timer_wheel_next_(const uint64_t *used, uint64_t now,
+		uint64_t *next) {
+	uint64_t group, bits;
+	size_t l, shift, r;
+
+	for(l = 0; l < TIMER_WHEEL_LEVELS; l++) {
+		shift = TIMER_WHEEL_BITS * l;
+		group = now >> shift;
+		// the current slot of a higher level comes up again a round later
+		r = (group + (l > 0)) & (TIMER_WHEEL_SLOTS - 1);
+		bits = used[l] >> r | used[l] << ((TIMER_WHEEL_SLOTS - r) &
+			(TIMER_WHEEL_SLOTS - 1));
+		if(bits) {
+			*next = (group + (l > 0) + timer_wheel_ctz_(bits)) << shift;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+#define TIMER_WHEEL_DEFINE(P, T) \
+struct P {\
+	T **slots;\
+	uint64_t used[TIMER_WHEEL_LEVELS];\
+	uint64_t now;\
+};\
+static inline void P##_place_(struct P *w, T *timer) {\
+	size_t i;\
+	i = timer_wheel_slot_(timer->expires, w->now);\
+	list_append(&w->slots[i], timer);\
+	w->used[i / TIMER_WHEEL_SLOTS] |= (uint64_t) 1 << (i % TIMER_WHEEL_SLOTS);\
+}\
+/* Moves the wheel to NOW and moves down the slots of the levels above that \
+ * start at NOW, highest level first */\
+static inline void P##_move_(struct P *w, uint64_t now) {\
+	T *list, *timer, *tmp;\
+	size_t l, i;\
+	w->now = now;\
+	for(l = TIMER_WHEEL_LEVELS - 1; l > 0; l--) {\
+		if(now & (((uint64_t) 1 << (TIMER_WHEEL_BITS * l)) - 1)) continue;\
+		i = (now >> (TIMER_WHEEL_BITS * l)) & (TIMER_WHEEL_SLOTS - 1);\
+		list = w->slots[l * TIMER_WHEEL_SLOTS + i];\
+		w->slots[l * TIMER_WHEEL_SLOTS + i] = list_null_;\
+		w->used[l] &= ~((uint64_t) 1 << i);\
+		list_foreach_safe(&list, timer, tmp) {\
+			list_remove(&list, timer);\
+			P##_place_(w, timer);\
+		}\
+	}\
+}\
+static inline void P##_init(struct P *w, uint64_t now) {\
+	size_t l;\
+	array_new(&w->slots, T*);\
+	array_append_n(w->slots, (T*) list_null_, \
+			TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS);\
+	for(l = 0; l < TIMER_WHEEL_LEVELS; l++) w->used[l] = 0;\
+	w->now = now;\
+}\
+static inline void P##_free(struct P *w) {\
+	array_free(w->slots);\
+}\
+static inline void P##_schedule(struct P *w, T *timer, uint64_t expires) {\
+	timer->expires = expires < w->now ? w->now : expires;\
+	P##_place_(w, timer);\
+}\
+static inline int P##_cancel(struct P *w, T *timer) {\
+	size_t i;\
+	if(!timer->next || timer->expires < w->now) return 0;\
+	i = timer_wheel_slot_(timer->expires, w->now);\
+	list_remove(&w->slots[i], timer);\
+	if(!w->slots[i]) {\
+		w->used[i / TIMER_WHEEL_SLOTS] &= \
+			~((uint64_t) 1 << (i % TIMER_WHEEL_SLOTS));\
+	}\
+	timer->next = list_null_;\
+	return 1;\
+}\
+static inline void P##_advance(struct P *w, uint64_t now, T **expired) {\
+	uint64_t next;\
+	size_t i;\
+	while(w->now <= now) {\
+		if(!timer_wheel_next_(w->used, w->now, &next) || next > now) {\
+			P##_move_(w, now + 1);\
+			break;\
+		}\
+		if(next > w->now) {\
+			P##_move_(w, next);\
+			continue;\
+		}\
+		i = w->now & (TIMER_WHEEL_SLOTS - 1);\
+		list_concat(expired, &w->slots[i]);\
+		w->used[0] &= ~((uint64_t) 1 << i);\
+		P##_move_(w, w->now + 1);\
+	}\
+}\
+static inline int P##_is_empty(struct P *w) {\
+	size_t l;\
+	for(l = 0; l < TIMER_WHEEL_LEVELS; l++) {\
+		if(w->used[l]) return 0;\
+	}\
+	return 1;\
 }
 
 #endif
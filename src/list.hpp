@@ -0,0 +1,457 @@
+#ifndef LIST_HPP
+#define LIST_HPP
+
+/* C++ wrappers for list.h
+ *
+ * circular_list is a view of a circular doubly linked list of nodes owned by
+ * the caller, dyn_array an owning handle of a dynamic array. Both come with
+ * iterators, so they work with range-for and the algorithms of the standard
+ * library, and both are nothing more than the pointer the list.h macros work
+ * with. That makes them as fast as the macros and lets lists and arrays be
+ * handed back and forth between C and C++ code:
+ * 	head() of a circular_list is the head pointer of the list, &head() is
+ * 	the LIST of the list.h macros
+ * 	get() of a dyn_array is the array pointer, release() gives up ownership
+ *
+ * Example:
+ * struct node {
+ * 	struct node *next;
+ * 	struct node *prev;
+ * 	int value;
+ * };
+ * circularlist::circular_list<node, &node::next, &node::prev> list;
+ * list.push_back(*new node());
+ * for(node &n : list) printf("%d\n", n.value);
+ *
+ * circularlist::dyn_array<int> values;
+ * values.push_back(42);
+ * std::sort(values.begin(), values.end());
+ *
+ * This header file is licensed under the same terms as list.h.
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "list.h"
+
+namespace circularlist {
+
+/* A circular doubly linked list of nodes of type T
+ *
+ * NEXT and PREV are the members linking the nodes, for nodes with the members
+ * /next/ and /prev/ they can be left out. The list never allocates or frees
+ * nodes, it only links them, and iterating is the same loop as list_foreach.
+ * The iterators are bidirectional, end() is a null node.
+ *
+ * The list can be moved but not copied, because two lists must never share
+ * nodes. size() walks the list, just like counting the nodes with
+ * list_foreach.
+ *
+ * Iterators point to their node and to the head pointer of their list, which
+ * tells them where the list ends. They stay valid when other nodes are added
+ * or removed, also when the head changes, like those of std::list. Removing
+ * their own node invalidates them, and so does moving or swapping the list,
+ * after which they would still look at the head of the old list object.
+ */
+template<class T, T *T::*Next = &T::next, T *T::*Prev = &T::prev>
+class circular_list {
+public:
+	template<class U>
+	class basic_iterator {
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef typename std::remove_const<U>::type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef U *pointer;
+		typedef U &reference;
+
+		basic_iterator() noexcept : node_(nullptr), head_(nullptr) {}
+		basic_iterator(T *node, T *const *head) noexcept :
+			node_(node), head_(head) {}
+
+		operator basic_iterator<const T>() const noexcept {
+			return basic_iterator<const T>(node_, head_);
+		}
+
+		reference operator*() const noexcept { return *node_; }
+		pointer operator->() const noexcept { return node_; }
+
+		basic_iterator &operator++() noexcept {
+			node_ = node_->*Next == *head_ ? nullptr : node_->*Next;
+			return *this;
+		}
+
+		basic_iterator operator++(int) noexcept {
+			basic_iterator it = *this;
+			++*this;
+			return it;
+		}
+
+		// decrementing end() gives the last node
+		basic_iterator &operator--() noexcept {
+			node_ = node_ ? node_->*Prev : (*head_)->*Prev;
+			return *this;
+		}
+
+		basic_iterator operator--(int) noexcept {
+			basic_iterator it = *this;
+			--*this;
+			return it;
+		}
+
+		bool operator==(const basic_iterator &o) const noexcept {
+			return node_ == o.node_;
+		}
+
+		bool operator!=(const basic_iterator &o) const noexcept {
+			return node_ != o.node_;
+		}
+
+		U *node() const noexcept { return node_; }
+
+	private:
+		friend class circular_list;
+
+		T *node_;
+		T *const *head_;
+	};
+
+	typedef T value_type;
+	typedef std::size_t size_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef T &reference;
+	typedef const T &const_reference;
+	typedef basic_iterator<T> iterator;
+	typedef basic_iterator<const T> const_iterator;
+	typedef std::reverse_iterator<iterator> reverse_iterator;
+	typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+	circular_list() noexcept : head_(nullptr) {}
+
+	// Wraps an existing list starting at HEAD
+	explicit circular_list(T *head) noexcept : head_(head) {}
+
+	circular_list(const circular_list&) = delete;
+	circular_list &operator=(const circular_list&) = delete;
+
+	circular_list(circular_list &&o) noexcept : head_(o.head_) {
+		o.head_ = nullptr;
+	}
+
+	// The nodes of this list end up in O, so none of them are lost
+	circular_list &operator=(circular_list &&o) noexcept {
+		swap(o);
+		return *this;
+	}
+
+	T *&head() noexcept { return head_; }
+	T *head() const noexcept { return head_; }
+
+	bool empty() const noexcept { return head_ == nullptr; }
+
+	size_type size() const noexcept {
+		size_type n = 0;
+		for(const_iterator it = begin(); it != end(); ++it) n++;
+		return n;
+	}
+
+	T &front() noexcept { return *head_; }
+	const T &front() const noexcept { return *head_; }
+	T &back() noexcept { return *(head_->*Prev); }
+	const T &back() const noexcept { return *(head_->*Prev); }
+
+	iterator begin() noexcept { return iterator(head_, &head_); }
+	iterator end() noexcept { return iterator(nullptr, &head_); }
+	const_iterator begin() const noexcept {
+		return const_iterator(head_, &head_);
+	}
+	const_iterator end() const noexcept {
+		return const_iterator(nullptr, &head_);
+	}
+	const_iterator cbegin() const noexcept { return begin(); }
+	const_iterator cend() const noexcept { return end(); }
+	reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+	reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+	const_reverse_iterator rbegin() const noexcept {
+		return const_reverse_iterator(end());
+	}
+	const_reverse_iterator rend() const noexcept {
+		return const_reverse_iterator(begin());
+	}
+
+	// Same as list_append
+	void push_back(T &node) noexcept {
+		list_stat_(appends, 1);
+		link_back_(node);
+	}
+
+	// Same as list_prepend
+	void push_front(T &node) noexcept {
+		list_stat_(prepends, 1);
+		link_back_(node);
+		head_ = &node;
+	}
+
+	// Inserts NODE in front of POS, which may be end()
+	iterator insert(const_iterator pos, T &node) noexcept {
+		T *before;
+
+		if(!pos.node_) {
+			push_back(node);
+		}
+		else {
+			list_stat_(inserts, 1);
+			before = pos.node_;
+			node.*Prev = before->*Prev;
+			node.*Next = before;
+			(before->*Prev)->*Next = &node;
+			before->*Prev = &node;
+			if(before == head_) head_ = &node;
+		}
+
+		return iterator(&node, &head_);
+	}
+
+	// Same as list_remove
+	void remove(T &node) noexcept {
+		list_stat_(removes, 1);
+		if(head_ == &node) head_ = node.*Next;
+		if(head_ == &node) {
+			head_ = nullptr;
+		}
+		else {
+			(node.*Next)->*Prev = node.*Prev;
+			(node.*Prev)->*Next = node.*Next;
+		}
+	}
+
+	// Removes the node at POS and returns the iterator to the node after it
+	iterator erase(const_iterator pos) noexcept {
+		T *node, *after;
+
+		node = pos.node_;
+		after = node->*Next == head_ ? nullptr : node->*Next;
+		remove(*node);
+
+		return iterator(after, &head_);
+	}
+
+	void pop_front() noexcept { remove(*head_); }
+	void pop_back() noexcept { remove(*(head_->*Prev)); }
+
+	// Same as list_concat, moves all nodes of O to the end of this list
+	void splice_back(circular_list &o) noexcept {
+		T *tail;
+
+		if(this == &o) return;
+
+		list_stat_(splices, 1);
+		if(head_ && o.head_) {
+			tail = head_->*Prev;
+			tail->*Next = o.head_;
+			head_->*Prev = o.head_->*Prev;
+			(o.head_->*Prev)->*Next = head_;
+			o.head_->*Prev = tail;
+		}
+		else if(o.head_) {
+			head_ = o.head_;
+		}
+		o.head_ = nullptr;
+	}
+
+	void swap(circular_list &o) noexcept { std::swap(head_, o.head_); }
+
+	// Forgets all nodes without touching them
+	void clear() noexcept { head_ = nullptr; }
+
+private:
+	void link_back_(T &node) noexcept {
+		if(!head_) {
+			head_ = &node;
+			node.*Next = &node;
+			node.*Prev = &node;
+		}
+		else {
+			node.*Next = head_;
+			node.*Prev = head_->*Prev;
+			(head_->*Prev)->*Next = &node;
+			head_->*Prev = &node;
+		}
+	}
+
+	T *head_;
+};
+
+/* A dynamic array of elements of type T
+ *
+ * This owns an array of the list.h macros and frees it with array_free, so it
+ * can also take over arrays from array_new, array_new_aligned or array_map.
+ * Ring buffers can't be taken over, their elements don't start at index 0.
+ * The elements are moved with realloc when the array grows, so T has to be
+ * trivially copyable. The iterators are plain pointers.
+ *
+ * A default constructed or moved from dyn_array holds no array at all, the
+ * array is only allocated when the first element is added. Allocation
+ * failures throw std::bad_alloc.
+ */
+template<class T>
+class dyn_array {
+	static_assert(std::is_trivially_copyable<T>::value,
+			"dyn_array elements are moved with realloc");
+
+public:
+	typedef T value_type;
+	typedef std::size_t size_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef T &reference;
+	typedef const T &const_reference;
+	typedef T *pointer;
+	typedef const T *const_pointer;
+	typedef T *iterator;
+	typedef const T *const_iterator;
+	typedef std::reverse_iterator<iterator> reverse_iterator;
+	typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+	dyn_array() noexcept : a_(nullptr) {}
+
+	// Takes over the array A
+	explicit dyn_array(T *a) noexcept : a_(a) {}
+
+	dyn_array(const dyn_array &o) : a_(nullptr) {
+		if(o.a_) {
+			reserve(o.size());
+			std::memcpy(a_, o.a_, o.size() * sizeof(T));
+			array_meta(a_)->count = o.size();
+		}
+	}
+
+	dyn_array(dyn_array &&o) noexcept : a_(o.a_) { o.a_ = nullptr; }
+
+	dyn_array &operator=(const dyn_array &o) {
+		dyn_array copy(o);
+		swap(copy);
+		return *this;
+	}
+
+	dyn_array &operator=(dyn_array &&o) noexcept {
+		swap(o);
+		return *this;
+	}
+
+	~dyn_array() {
+		if(a_) array_free(a_);
+	}
+
+	T *get() const noexcept { return a_; }
+
+	// Gives up ownership of the array, which has to be freed with array_free
+	T *release() noexcept {
+		T *a = a_;
+		a_ = nullptr;
+		return a;
+	}
+
+	size_type size() const noexcept { return a_ ? array_len(a_) : 0; }
+	size_type capacity() const noexcept {
+		return a_ ? array_allocated(a_) : 0;
+	}
+	bool empty() const noexcept { return size() == 0; }
+
+	T *data() noexcept { return a_; }
+	const T *data() const noexcept { return a_; }
+
+	T &operator[](size_type i) noexcept { return a_[i]; }
+	const T &operator[](size_type i) const noexcept { return a_[i]; }
+
+	T &at(size_type i) {
+		if(i >= size()) throw std::out_of_range("dyn_array::at");
+		return a_[i];
+	}
+
+	const T &at(size_type i) const {
+		if(i >= size()) throw std::out_of_range("dyn_array::at");
+		return a_[i];
+	}
+
+	T &front() noexcept { return a_[0]; }
+	const T &front() const noexcept { return a_[0]; }
+	T &back() noexcept { return a_[array_len(a_) - 1]; }
+	const T &back() const noexcept { return a_[array_len(a_) - 1]; }
+
+	iterator begin() noexcept { return a_; }
+	iterator end() noexcept { return a_ + size(); }
+	const_iterator begin() const noexcept { return a_; }
+	const_iterator end() const noexcept { return a_ + size(); }
+	const_iterator cbegin() const noexcept { return begin(); }
+	const_iterator cend() const noexcept { return end(); }
+	reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+	reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+	const_reverse_iterator rbegin() const noexcept {
+		return const_reverse_iterator(end());
+	}
+	const_reverse_iterator rend() const noexcept {
+		return const_reverse_iterator(begin());
+	}
+
+	// Same as array_reserve
+	void reserve(size_type n) {
+		if(!a_ || array_allocated(a_) < n) grow_(n);
+	}
+
+	// Same as array_append
+	void push_back(const T &e) {
+		if(!a_ || array_len(a_) == array_allocated(a_)) grow_(size() + 1);
+		a_[array_meta(a_)->count++] = e;
+	}
+
+	template<class... Args>
+	T &emplace_back(Args&&... args) {
+		T *e;
+
+		if(!a_ || array_len(a_) == array_allocated(a_)) grow_(size() + 1);
+		e = new(a_ + array_len(a_)) T(std::forward<Args>(args)...);
+		array_meta(a_)->count++;
+
+		return *e;
+	}
+
+	void pop_back() noexcept { array_meta(a_)->count--; }
+
+	// Changes the length to N, new elements are value-initialized
+	void resize(size_type n) {
+		size_type i;
+
+		reserve(n);
+		for(i = array_len(a_); i < n; i++) new(a_ + i) T();
+		array_meta(a_)->count = n;
+	}
+
+	void clear() noexcept {
+		if(a_) array_meta(a_)->count = 0;
+	}
+
+	void swap(dyn_array &o) noexcept { std::swap(a_, o.a_); }
+
+private:
+	// Makes room for at least N elements, allocating the array if needed
+	void grow_(size_type n) {
+		if(!a_) {
+			array_new(&a_, T);
+			if(!a_) throw std::bad_alloc();
+		}
+		// the array stays as it is when this fails
+		if(array_reserve_checked(a_, n) < 0) throw std::bad_alloc();
+	}
+
+	T *a_;
+};
+
+} // namespace circularlist
+
+#endif
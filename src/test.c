@@ -6,8 +6,42 @@
  * If a test functions returns a non-zero value, it is deemed as an error.
  */
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+
+// map arrays early so the tests do not need huge arrays
+#define ARRAY_MMAP_THRESHOLD 4096
+
+/* All allocations of list.h go through these counters, see
+ * test_allocation_hooks. LIST_CALLOC is left to fall back on LIST_MALLOC.
+ * Allocations larger than test_alloc_limit fail, unless it is 0.
+ */
+static long test_allocs;
+static long test_frees;
+static size_t test_alloc_limit;
+
+static void *test_malloc(size_t size) {
+	if(test_alloc_limit && size > test_alloc_limit) return NULL;
+	__atomic_add_fetch(&test_allocs, 1, __ATOMIC_RELAXED);
+	return malloc(size);
+}
+
+static void *test_realloc(void *p, size_t size) {
+	if(test_alloc_limit && size > test_alloc_limit) return NULL;
+	if(!p) __atomic_add_fetch(&test_allocs, 1, __ATOMIC_RELAXED);
+	return realloc(p, size);
+}
+
+static void test_free(void *p) {
+	if(p) __atomic_add_fetch(&test_frees, 1, __ATOMIC_RELAXED);
+	free(p);
+}
+
+#define LIST_MALLOC(S) test_malloc(S)
+#define LIST_REALLOC(P, S) test_realloc(P, S)
+#define LIST_FREE(P) test_free(P)
 #include "list.h"
 
 typedef int (*testfunc_t)();
@@ -37,6 +71,78 @@ struct element {
 	char id;
 };
 
+/* The same element for index lists
+ */
+struct ielement {
+	uint32_t next;
+	uint32_t prev;
+	char id;
+};
+
+LIST_DEFINE(element, struct element)
+ARRAY_DEFINE(ints, int)
+
+struct snode {
+	struct snode *next;
+	struct snode *prev;
+	struct snode *skip[4];
+	int key;
+	int seq;
+};
+
+int cmp_key(const void *a, const void *b) {
+	return ((struct snode*) a)->key - ((struct snode*) b)->key;
+}
+
+SKIPLIST_DEFINE(snodes, struct snode, cmp_key)
+
+int cmp_int(const int *a, const int *b) {
+	return *a - *b;
+}
+
+HEAP_DEFINE(heap2, int, cmp_int, 2)
+HEAP_DEFINE(heap4, int, cmp_int, 4)
+
+struct job {
+	int prio;
+	int id;
+};
+
+/* Index of every job in the tracked heap */
+size_t job_pos[1000];
+
+int cmp_job(const struct job *a, const struct job *b) {
+	return a->prio - b->prio;
+}
+
+#define job_moved(E, IDX) (job_pos[(E)->id] = (IDX))
+
+HEAP_DEFINE_TRACKED(jobs, struct job, cmp_job, 4, job_moved)
+
+struct centry {
+	struct centry *next;
+	struct centry *prev;
+	int key;
+};
+
+#define hash_centry(E) lru_hash((E)->key)
+#define eq_centry(A, B) ((A)->key == (B)->key)
+// only a few different hashes, so removals have to fix up long probe runs
+#define bad_hash_centry(E) ((E)->key % 5)
+
+LRU_DEFINE(cache, struct centry, hash_centry, eq_centry)
+LRU_DEFINE(bad_cache, struct centry, bad_hash_centry, eq_centry)
+
+struct timer {
+	struct timer *next;
+	struct timer *prev;
+	uint64_t expires;
+	int armed;
+};
+
+TIMER_WHEEL_DEFINE(timers, struct timer)
+UNROLLED_DEFINE(unrolled, int, 4)
+
 struct element* create_element(char id) {
 	struct element *elm;
 
@@ -52,6 +158,42 @@ struct element* create_element(char id) {
 	return elm;
 }
 
+int cmp_id(const void *a, const void *b) {
+	return ((struct element*) a)->id - ((struct element*) b)->id;
+}
+
+/* Checks that all links of a list are consistent and that it has N nodes */
+int check_links(struct element **list, int n) {
+	int i;
+	struct element *node;
+
+	i = 0;
+	list_foreach(list, node) {
+		tassert(node->next->prev == node);
+		tassert(node->prev->next == node);
+		i++;
+	}
+	tassert(i == n);
+
+	return 0;
+}
+
+/* Checks that a list contains exactly the nodes in EXPECTED in that order */
+int check_order(struct element **list, struct element **expected, int n) {
+	int i;
+	struct element *node;
+
+	tassert(check_links(list, n) == 0);
+
+	i = 0;
+	list_foreach(list, node) {
+		tassert(node == expected[i]);
+		i++;
+	}
+
+	return 0;
+}
+
 int test_empty_list() {
 	struct element *list;
 
@@ -657,6 +799,2258 @@ int test_iteration_until() {
 	return 0;
 }
 
+int test_pool_reuse() {
+	struct list_pool *pool;
+	struct element *elmA, *elmB, *elmC;
+
+	pool = list_pool_new(struct element, 2);
+	tassert(pool != NULL);
+
+	elmA = list_pool_alloc(pool);
+	elmB = list_pool_alloc(pool);
+	elmC = list_pool_alloc(pool); // second chunk
+
+	tassert(elmA && elmB && elmC);
+	tassert(elmA != elmB && elmB != elmC && elmA != elmC);
+	tassert(elmA->next == NULL && elmA->prev == NULL && elmA->id == 0);
+
+	elmB->id = 'B';
+	list_pool_release(pool, elmB);
+
+	// released nodes are handed out again and zeroed
+	tassert(list_pool_alloc(pool) == elmB);
+	tassert(elmB->id == 0);
+
+	list_pool_free(pool);
+
+	return 0;
+}
+
+int test_pool_list() {
+	int i;
+	struct list_pool *pool;
+	struct element *list, *node;
+
+	pool = list_pool_new(struct element, 3);
+	list = NULL;
+
+	for(i = 0; i < 10; i++) {
+		node = list_pool_alloc(pool);
+		node->id = 'A' + i;
+		list_append(&list, node);
+	}
+
+	i = 0;
+	list_foreach(&list, node) {
+		tassert(node->id == 'A' + i);
+		i++;
+	}
+	tassert(i == 10);
+
+	list_pool_free_list(&list, pool);
+	tassert(list_is_empty(&list));
+
+	return 0;
+}
+
+int test_array_reserve() {
+	int *vals;
+
+	array_new(&vals, int);
+
+	tassert(array_len(vals) == 0);
+	tassert(array_allocated(vals) == 0);
+
+	array_reserve(vals, 1);
+	tassert(array_allocated(vals) == 8);
+
+	array_reserve(vals, 100);
+	tassert(array_allocated(vals) == 128);
+	tassert(array_len(vals) == 0);
+
+	array_free(vals);
+
+	return 0;
+}
+
+int test_array_extend() {
+	int i;
+	int *vals;
+	int others[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+
+	array_new(&vals, int);
+
+	array_append(vals, 0);
+	array_extend(vals, others, 10);
+
+	tassert(array_len(vals) == 11);
+	tassert(array_allocated(vals) == 16);
+	for(i = 0; i < 11; i++) tassert(vals[i] == i);
+
+	array_extend(vals, others, 0);
+	tassert(array_len(vals) == 11);
+
+	array_append_n(vals, 42, 3);
+	tassert(array_len(vals) == 14);
+	tassert(vals[10] == 10);
+	tassert(vals[11] == 42 && vals[12] == 42 && vals[13] == 42);
+
+	array_free(vals);
+
+	return 0;
+}
+
+int test_array_insert_n() {
+	int i;
+	int *vals;
+	int others[] = {10, 11, 12};
+	int expected[] = {10, 11, 12, 0, 1, 10, 11, 12, 2, 3, 10, 11, 12};
+
+	array_new(&vals, int);
+
+	for(i = 0; i < 4; i++) array_append(vals, i);
+
+	array_insert_n(vals, 2, others, 3); // middle
+	array_insert_n(vals, 0, others, 3); // front
+	array_insert_n(vals, array_len(vals), others, 3); // back
+
+	tassert(array_len(vals) == 13);
+	for(i = 0; i < 13; i++) tassert(vals[i] == expected[i]);
+
+	array_free(vals);
+
+	return 0;
+}
+
+int test_define_list() {
+	int i;
+	struct element *list, *tmp, *elms[5];
+
+	list = NULL;
+
+	for(i = 0; i < 5; i++) elms[i] = create_element('A' + i);
+
+	tassert(element_is_empty(list));
+	tassert(element_last(list) == NULL);
+
+	// arguments with side effects are evaluated once
+	i = 0;
+	element_append(&list, elms[i++]);
+	tassert(i == 1);
+	element_append(&list, elms[i++]);
+	element_insert_after(&list, elms[i++], elms[1]);
+	element_prepend(&list, elms[i++]);
+	element_insert_before(&list, elms[i++], elms[3]);
+	tassert(i == 5);
+
+	// E D A B C
+	tassert(list == elms[4]);
+	tassert(element_first(list) == elms[4]);
+	tassert(element_last(list) == elms[2]);
+
+	i = 0;
+	for(tmp = element_first(list); tmp; tmp = element_next(list, tmp)) {
+		switch(i) {
+			case 0: tassert(tmp == elms[4]); break;
+			case 1: tassert(tmp == elms[3]); break;
+			case 2: tassert(tmp == elms[0]); break;
+			case 3: tassert(tmp == elms[1]); break;
+			case 4: tassert(tmp == elms[2]); break;
+			default: tassert(FALSE && "unreachable"); break;
+		}
+		i++;
+	}
+	tassert(i == 5);
+
+	i = 0;
+	for(tmp = element_last(list); tmp; tmp = element_prev(list, tmp)) {
+		switch(i) {
+			case 0: tassert(tmp == elms[2]); break;
+			case 1: tassert(tmp == elms[1]); break;
+			case 2: tassert(tmp == elms[0]); break;
+			case 3: tassert(tmp == elms[3]); break;
+			case 4: tassert(tmp == elms[4]); break;
+			default: tassert(FALSE && "unreachable"); break;
+		}
+		i++;
+	}
+	tassert(i == 5);
+
+	for(i = 0; i < 5; i++) element_remove(&list, elms[i]);
+	tassert(element_is_empty(list));
+
+	for(i = 0; i < 5; i++) free(elms[i]);
+
+	return 0;
+}
+
+int test_define_array() {
+	int i;
+	int *vals;
+	int others[] = {7, 8, 9};
+
+	vals = ints_new();
+	tassert(ints_len(vals) == 0);
+
+	i = 0;
+	ints_append(&vals, i++);
+	tassert(i == 1);
+	ints_append(&vals, i++);
+
+	ints_reserve(&vals, 32);
+	tassert(array_allocated(vals) == 32);
+
+	ints_extend(&vals, others, 3);
+	ints_insert_n(&vals, 1, others, 2);
+
+	tassert(ints_len(vals) == 7);
+	tassert(vals[0] == 0 && vals[1] == 7 && vals[2] == 8 && vals[3] == 1);
+	tassert(vals[4] == 7 && vals[5] == 8 && vals[6] == 9);
+
+	ints_free(vals);
+
+	return 0;
+}
+
+int test_sort() {
+	int i;
+	struct element *list, *node, *elms[5];
+	char ids[] = {'C', 'A', 'C', 'B', 'A'};
+
+	list = NULL;
+
+	list_sort(&list, cmp_id);
+	tassert(list_is_empty(&list));
+
+	for(i = 0; i < 5; i++) {
+		elms[i] = create_element(ids[i]);
+		list_append(&list, elms[i]);
+	}
+
+	list_sort(&list, cmp_id);
+
+	tassert(check_links(&list, 5) == 0);
+
+	// equal nodes keep their order
+	i = 0;
+	list_foreach(&list, node) {
+		switch(i) {
+			case 0: tassert(node == elms[1]); break;
+			case 1: tassert(node == elms[4]); break;
+			case 2: tassert(node == elms[3]); break;
+			case 3: tassert(node == elms[0]); break;
+			case 4: tassert(node == elms[2]); break;
+			default: tassert(FALSE && "unreachable"); break;
+		}
+		i++;
+	}
+
+	for(i = 0; i < 5; i++) free(elms[i]);
+
+	return 0;
+}
+
+int test_sort_large() {
+	int i;
+	struct element *list, *node, *tmp;
+
+	list = NULL;
+	srand(1);
+
+	for(i = 0; i < 1000; i++) {
+		node = create_element(rand() % 100);
+		list_append(&list, node);
+	}
+
+	list_sort(&list, cmp_id);
+
+	tassert(check_links(&list, 1000) == 0);
+	list_foreach(&list, node) {
+		if(node->next != list) tassert(node->id <= node->next->id);
+	}
+
+	list_foreach_safe(&list, node, tmp) {
+		list_remove(&list, node);
+		free(node);
+	}
+
+	return 0;
+}
+
+int test_merge_sorted() {
+	int i;
+	struct element *a, *b, *node, *elms[6];
+	char ids[] = {'A', 'C', 'E', 'B', 'C', 'F'};
+
+	a = NULL;
+	b = NULL;
+
+	for(i = 0; i < 6; i++) elms[i] = create_element(ids[i]);
+	for(i = 0; i < 3; i++) list_append(&a, elms[i]);
+
+	// merging an empty list changes nothing
+	list_merge_sorted(&a, &b, cmp_id);
+	tassert(check_links(&a, 3) == 0);
+	tassert(list_is_empty(&b));
+
+	for(i = 3; i < 6; i++) list_append(&b, elms[i]);
+
+	list_merge_sorted(&a, &b, cmp_id);
+
+	tassert(list_is_empty(&b));
+	tassert(check_links(&a, 6) == 0);
+
+	i = 0;
+	list_foreach(&a, node) {
+		switch(i) {
+			case 0: tassert(node == elms[0]); break;
+			case 1: tassert(node == elms[3]); break;
+			case 2: tassert(node == elms[1]); break;
+			case 3: tassert(node == elms[4]); break;
+			case 4: tassert(node == elms[2]); break;
+			case 5: tassert(node == elms[5]); break;
+			default: tassert(FALSE && "unreachable"); break;
+		}
+		i++;
+	}
+
+	// merging into an empty list moves everything
+	list_merge_sorted(&b, &a, cmp_id);
+	tassert(list_is_empty(&a));
+	tassert(check_links(&b, 6) == 0);
+
+	for(i = 0; i < 6; i++) free(elms[i]);
+
+	return 0;
+}
+
+int test_concat() {
+	int i;
+	struct element *a, *b, *elms[5];
+
+	a = NULL;
+	b = NULL;
+
+	for(i = 0; i < 5; i++) elms[i] = create_element('A' + i);
+
+	list_concat(&a, &b);
+	tassert(list_is_empty(&a) && list_is_empty(&b));
+
+	list_append(&b, elms[0]);
+	list_concat(&a, &b);
+	tassert(list_is_empty(&b));
+	tassert(check_order(&a, elms, 1) == 0);
+
+	list_append(&a, elms[1]);
+	list_append(&b, elms[2]);
+	list_append(&b, elms[3]);
+	list_append(&b, elms[4]);
+	list_concat(&a, &b);
+
+	tassert(list_is_empty(&b));
+	tassert(check_order(&a, elms, 5) == 0);
+
+	for(i = 0; i < 5; i++) free(elms[i]);
+
+	return 0;
+}
+
+int test_splice_after() {
+	int i;
+	struct element *list, *other, *elms[5], *expected[5];
+
+	list = NULL;
+	other = NULL;
+
+	for(i = 0; i < 5; i++) elms[i] = create_element('A' + i);
+
+	list_append(&list, elms[0]);
+	list_append(&list, elms[1]);
+	list_append(&other, elms[2]);
+	list_append(&other, elms[3]);
+	list_append(&other, elms[4]);
+
+	list_splice_after(&list, elms[0], &other);
+	tassert(list_is_empty(&other));
+
+	expected[0] = elms[0];
+	expected[1] = elms[2];
+	expected[2] = elms[3];
+	expected[3] = elms[4];
+	expected[4] = elms[1];
+	tassert(check_order(&list, expected, 5) == 0);
+
+	// splicing an empty list changes nothing
+	list_splice_after(&list, elms[1], &other);
+	tassert(check_order(&list, expected, 5) == 0);
+
+	for(i = 0; i < 5; i++) free(elms[i]);
+
+	return 0;
+}
+
+int test_split() {
+	int i;
+	struct element *list, *out, *elms[5];
+
+	list = NULL;
+	out = NULL;
+
+	for(i = 0; i < 5; i++) {
+		elms[i] = create_element('A' + i);
+		list_append(&list, elms[i]);
+	}
+
+	list_split(&list, elms[2], &out);
+
+	tassert(check_order(&list, elms, 2) == 0);
+	tassert(check_order(&out, elms + 2, 3) == 0);
+
+	// splitting at the head moves everything
+	list_split(&out, elms[2], &list);
+	tassert(list_is_empty(&out));
+	tassert(check_order(&list, elms + 2, 3) == 0);
+
+	for(i = 0; i < 5; i++) free(elms[i]);
+
+	return 0;
+}
+
+int test_rotate() {
+	int i;
+	struct element *list, *elms[4];
+
+	list = NULL;
+
+	list_rotate(&list, 3);
+	tassert(list_is_empty(&list));
+
+	for(i = 0; i < 4; i++) {
+		elms[i] = create_element('A' + i);
+		list_append(&list, elms[i]);
+	}
+
+	list_rotate(&list, 1);
+	tassert(list == elms[1]);
+
+	list_rotate(&list, -2);
+	tassert(list == elms[3]);
+
+	list_rotate(&list, 5);
+	tassert(list == elms[0]);
+	tassert(check_order(&list, elms, 4) == 0);
+
+	list_rotate(&list, 0);
+	tassert(list == elms[0]);
+
+	for(i = 0; i < 4; i++) free(elms[i]);
+
+	return 0;
+}
+
+/* Checks that an unrolled list contains exactly the N values in EXPECTED */
+int check_unrolled(struct unrolled **list, int *expected, int n) {
+	int i, j;
+	struct unrolled *node;
+
+	tassert(unrolled_len(*list) == n);
+
+	j = 0;
+	unrolled_foreach(list, node, i) {
+		tassert(node->count > 0 && node->count <= 4);
+		tassert(node->next->prev == node && node->prev->next == node);
+		tassert(node->items[i] == expected[j]);
+		j++;
+	}
+	tassert(j == n);
+
+	unrolled_foreach_reverse(list, node, i) {
+		j--;
+		tassert(node->items[i] == expected[j]);
+	}
+	tassert(j == 0);
+
+	return 0;
+}
+
+int test_unrolled_append() {
+	int i;
+	int expected[20];
+	struct unrolled *list;
+
+	list = NULL;
+
+	tassert(unrolled_len(list) == 0);
+
+	for(i = 0; i < 10; i++) {
+		tassert(unrolled_append(&list, i + 10) == 0);
+		tassert(unrolled_prepend(&list, 9 - i) == 0);
+	}
+	for(i = 0; i < 20; i++) expected[i] = i;
+
+	tassert(check_unrolled(&list, expected, 20) == 0);
+
+	unrolled_free(&list);
+	tassert(list_is_empty(&list));
+
+	return 0;
+}
+
+int test_unrolled_insert() {
+	int i;
+	int expected[] = {0, 1, 100, 2, 3, 101, 4, 5, 6, 7};
+	struct unrolled *list;
+
+	list = NULL;
+
+	for(i = 0; i < 8; i++) unrolled_append(&list, i);
+
+	// both nodes are full, so these split them
+	unrolled_insert(&list, list, 2, 100);
+	unrolled_insert(&list, list->next, 2, 101);
+
+	tassert(check_unrolled(&list, expected, 10) == 0);
+
+	unrolled_free(&list);
+
+	return 0;
+}
+
+int test_unrolled_removal() {
+	int i, j;
+	int odd[10], rest[16];
+	struct unrolled *list, *node;
+
+	list = NULL;
+
+	for(i = 0; i < 20; i++) unrolled_append(&list, i);
+
+	// remove all even values
+	j = 0;
+	unrolled_foreach_safe(&list, node, i) {
+		tassert(node->items[i] == j);
+		if(node->items[i] % 2 == 0) unrolled_erase(&list, &node, &i);
+		j++;
+	}
+	tassert(j == 20);
+
+	for(i = 0; i < 10; i++) odd[i] = 2 * i + 1;
+	tassert(check_unrolled(&list, odd, 10) == 0);
+
+	// remove everything in reverse
+	j = 9;
+	unrolled_foreach_reverse_safe(&list, node, i) {
+		tassert(node->items[i] == odd[j]);
+		unrolled_erase_reverse(&list, &node, &i);
+		j--;
+	}
+	tassert(j == -1);
+	tassert(list_is_empty(&list));
+
+	for(i = 0; i < 20; i++) unrolled_append(&list, i);
+
+	// remove 0, 1, 2, 3 and 4 from the front and 19 from the back
+	for(i = 0; i < 5; i++) unrolled_remove(&list, list, 0);
+	unrolled_remove(&list, list->prev, list->prev->count - 1);
+
+	for(i = 0; i < 14; i++) rest[i] = i + 5;
+	tassert(check_unrolled(&list, rest, 14) == 0);
+
+	unrolled_free(&list);
+
+	return 0;
+}
+
+int test_ilist() {
+	int i;
+	uint32_t list, free_nodes, idx, elms[5];
+	struct ielement *nodes;
+	char expected[] = {'B', 'A', 'E', 'C', 'D'};
+
+	array_new(&nodes, struct ielement);
+	list = ilist_null;
+	free_nodes = ilist_null;
+
+	tassert(ilist_is_empty(&list));
+
+	for(i = 0; i < 5; i++) {
+		ilist_alloc(nodes, &free_nodes, elms[i]);
+		nodes[elms[i]].id = 'A' + i;
+	}
+	tassert(array_len(nodes) == 5);
+
+	ilist_append(nodes, &list, elms[0]);
+	ilist_prepend(nodes, &list, elms[1]);
+	ilist_append(nodes, &list, elms[2]);
+	ilist_append(nodes, &list, elms[3]);
+	ilist_insert_after(nodes, &list, elms[4], elms[0]);
+	ilist_remove(nodes, &list, elms[2]);
+	ilist_insert_before(nodes, &list, elms[2], elms[3]);
+	ilist_remove(nodes, &list, elms[3]);
+	ilist_append(nodes, &list, elms[3]);
+
+	// B A E C D
+	i = 0;
+	ilist_foreach(nodes, &list, idx) {
+		tassert(nodes[idx].id == expected[i]);
+		tassert(nodes[nodes[idx].next].prev == idx);
+		i++;
+	}
+	tassert(i == 5);
+
+	ilist_foreach_reverse(nodes, &list, idx) {
+		i--;
+		tassert(nodes[idx].id == expected[i]);
+	}
+	tassert(i == 0);
+
+	array_free(nodes);
+
+	return 0;
+}
+
+int test_ilist_release() {
+	int i;
+	uint32_t list, free_nodes, idx, tmp;
+	struct ielement *nodes;
+
+	array_new(&nodes, struct ielement);
+	list = ilist_null;
+	free_nodes = ilist_null;
+
+	for(i = 0; i < 60; i++) {
+		ilist_alloc(nodes, &free_nodes, idx);
+		nodes[idx].id = i;
+		ilist_append(nodes, &list, idx);
+	}
+
+	// remove every odd node
+	ilist_foreach_safe(nodes, &list, idx, tmp) {
+		if(nodes[idx].id % 2) {
+			ilist_remove(nodes, &list, idx);
+			ilist_release(nodes, &free_nodes, idx);
+		}
+	}
+
+	// released nodes are reused before the array grows
+	for(i = 0; i < 30; i++) {
+		ilist_alloc(nodes, &free_nodes, idx);
+		tassert(nodes[idx].id == 0);
+		nodes[idx].id = 60 + i;
+		ilist_append(nodes, &list, idx);
+	}
+	tassert(array_len(nodes) == 60);
+	tassert(ilist_is_empty(&free_nodes));
+
+	i = 0;
+	ilist_foreach(nodes, &list, idx) {
+		tassert(nodes[idx].id == (i < 30 ? 2 * i : 30 + i));
+		i++;
+	}
+	tassert(i == 60);
+
+	// empty it in reverse
+	i = 59;
+	ilist_foreach_reverse_safe(nodes, &list, idx, tmp) {
+		tassert(nodes[idx].id == (i < 30 ? 2 * i : 30 + i));
+		ilist_remove(nodes, &list, idx);
+		i--;
+	}
+	tassert(i == -1);
+	tassert(ilist_is_empty(&list));
+
+	// a full array gives no node instead of wrapping around, the length is
+	// faked since 2^32 - 1 nodes don't fit into a test
+	array_meta(nodes)->count = ilist_null;
+	ilist_alloc(nodes, &free_nodes, idx);
+	tassert(idx == ilist_null);
+	tassert(array_len(nodes) == ilist_null);
+	ilist_release(nodes, &free_nodes, 7);
+	ilist_alloc(nodes, &free_nodes, idx);
+	tassert(idx == 7);
+	array_meta(nodes)->count = 60;
+
+	// index links take half the space of pointers on 64-bit machines
+	if(sizeof(void*) == 8) {
+		tassert(sizeof(struct ielement) * 2 <= sizeof(struct element));
+	}
+
+	array_free(nodes);
+
+	return 0;
+}
+
+/* Nodes for the queue stress test
+ */
+struct qelement {
+	struct qelement *next;
+	struct qelement *prev;
+	int producer;
+	int seq;
+};
+
+#define QUEUE_PRODUCERS 4
+#define QUEUE_NODES 20000
+
+struct producer {
+	struct list_mpsc *queue;
+	struct qelement *nodes;
+	int id;
+};
+
+void *produce(void *arg) {
+	int i;
+	struct producer *p;
+
+	p = arg;
+
+	for(i = 0; i < QUEUE_NODES; i++) {
+		p->nodes[i].producer = p->id;
+		p->nodes[i].seq = i;
+		list_mpsc_push(p->queue, &p->nodes[i]);
+	}
+
+	return NULL;
+}
+
+int test_mpsc_single() {
+	int i;
+	struct list_mpsc queue;
+	struct element *list, *node, *elms[3];
+
+	list_mpsc_init(&queue, struct element);
+	list = NULL;
+
+	tassert(list_mpsc_is_empty(&queue));
+
+	list_mpsc_pop_all(&queue, &list);
+	tassert(list_is_empty(&list));
+
+	for(i = 0; i < 3; i++) {
+		elms[i] = create_element('A' + i);
+		list_mpsc_push(&queue, elms[i]);
+	}
+	tassert(!list_mpsc_is_empty(&queue));
+
+	list_mpsc_pop_all(&queue, &list);
+	tassert(list_mpsc_is_empty(&queue));
+	tassert(check_order(&list, elms, 3) == 0);
+
+	// nodes can go from the list back into the queue
+	node = list;
+	list_remove(&list, node);
+	list_mpsc_push(&queue, node);
+	list_mpsc_pop_all(&queue, &list);
+
+	tassert(list == elms[1]);
+	tassert(list->next == elms[2] && list->prev == elms[0]);
+
+	for(i = 0; i < 3; i++) free(elms[i]);
+
+	return 0;
+}
+
+int test_mpsc_threads() {
+	int i, received, last[QUEUE_PRODUCERS];
+	pthread_t threads[QUEUE_PRODUCERS];
+	struct producer producers[QUEUE_PRODUCERS];
+	struct list_mpsc queue;
+	struct qelement *batch, *node, *tmp;
+
+	list_mpsc_init(&queue, struct qelement);
+
+	for(i = 0; i < QUEUE_PRODUCERS; i++) {
+		producers[i].queue = &queue;
+		producers[i].nodes = calloc(QUEUE_NODES, sizeof(struct qelement));
+		producers[i].id = i;
+		last[i] = -1;
+		tassert(producers[i].nodes != NULL);
+		tassert(pthread_create(&threads[i], NULL, produce,
+					&producers[i]) == 0);
+	}
+
+	// consume while the producers are still running
+	received = 0;
+	while(received < QUEUE_PRODUCERS * QUEUE_NODES) {
+		batch = NULL;
+		list_mpsc_pop_all(&queue, &batch);
+
+		list_foreach_safe(&batch, node, tmp) {
+			tassert(node->next->prev == node);
+			// nodes of a single producer arrive in order
+			tassert(node->seq == last[node->producer] + 1);
+			last[node->producer] = node->seq;
+			list_remove(&batch, node);
+			received++;
+		}
+	}
+
+	for(i = 0; i < QUEUE_PRODUCERS; i++) {
+		pthread_join(threads[i], NULL);
+		tassert(last[i] == QUEUE_NODES - 1);
+		free(producers[i].nodes);
+	}
+
+	tassert(list_mpsc_is_empty(&queue));
+
+	return 0;
+}
+
+int test_prefetch_iteration() {
+	int i, dist;
+	struct element *list, *node, *elms[5];
+
+	list = NULL;
+
+	list_foreach_prefetch(&list, node, 4) {
+		tassert(FALSE && "unreachable");
+	}
+	list_foreach_prefetch_reverse(&list, node, 4) {
+		tassert(FALSE && "unreachable");
+	}
+
+	for(i = 0; i < 5; i++) {
+		elms[i] = create_element('A' + i);
+		list_append(&list, elms[i]);
+	}
+
+	// distances longer than the list work as well
+	for(dist = 0; dist < 8; dist++) {
+		i = 0;
+		list_foreach_prefetch(&list, node, dist) {
+			tassert(node == elms[i]);
+			i++;
+		}
+		tassert(i == 5);
+		tassert(node == NULL);
+
+		list_foreach_prefetch_reverse(&list, node, dist) {
+			i--;
+			tassert(node == elms[i]);
+		}
+		tassert(i == 0);
+		tassert(node == NULL);
+	}
+
+	// break leaves the whole iteration
+	i = 0;
+	list_foreach_prefetch(&list, node, 2) {
+		if(node == elms[2]) break;
+		i++;
+	}
+	tassert(i == 2);
+	tassert(node == elms[2]);
+
+	for(i = 0; i < 5; i++) free(elms[i]);
+
+	return 0;
+}
+
+int test_prefetch_iteration_removal() {
+	int i, dist;
+	struct element *list, *node, *tmp;
+
+	for(dist = 0; dist < 8; dist++) {
+		list = NULL;
+		for(i = 0; i < 5; i++) {
+			node = create_element('A' + i);
+			list_append(&list, node);
+		}
+
+		// remove B and D
+		i = 0;
+		list_foreach_prefetch_safe(&list, node, tmp, dist) {
+			tassert(node->id == 'A' + i);
+			if(i % 2) {
+				list_remove(&list, node);
+				free(node);
+			}
+			i++;
+		}
+		tassert(i == 5);
+		tassert(check_links(&list, 3) == 0);
+
+		i = 0;
+		list_foreach_prefetch_reverse_safe(&list, node, tmp, dist) {
+			tassert(node->id == 'E' - 2 * i);
+			list_remove(&list, node);
+			free(node);
+			i++;
+		}
+		tassert(i == 3);
+		tassert(list_is_empty(&list));
+	}
+
+	return 0;
+}
+
+int test_array_growth() {
+	int i;
+	long *vals;
+
+	array_new(&vals, long);
+
+	// metadata is large enough for arrays beyond 2^31 bytes
+	tassert(sizeof(array_len(vals)) == sizeof(size_t));
+	tassert(sizeof(array_allocated(vals)) == sizeof(size_t));
+
+	// 1.5x from 32 elements on
+	array_set_growth(vals, ARRAY_GROW_HALF, 32, 0);
+	for(i = 0; i < 33; i++) array_append(vals, i);
+	tassert(array_allocated(vals) == 48);
+	array_reserve(vals, 49);
+	tassert(array_allocated(vals) == 72);
+
+	// fixed steps of 100 elements from 100 elements on
+	array_set_growth(vals, ARRAY_GROW_STEP, 100, 100);
+	array_reserve(vals, 73);
+	tassert(array_allocated(vals) == 144);
+	array_reserve(vals, 145);
+	tassert(array_allocated(vals) == 244);
+	array_reserve(vals, 1000);
+	tassert(array_allocated(vals) == 1044);
+
+	for(i = 0; i < 33; i++) tassert(vals[i] == i);
+	tassert(array_len(vals) == 33);
+
+	array_free(vals);
+
+	return 0;
+}
+
+int test_array_mmap() {
+	long i;
+	long *vals, *heap;
+
+	array_new_mode(&vals, long, ARRAY_MODE_HUGE);
+	array_new(&heap, long);
+
+	// small arrays stay on the heap until the threshold is reached
+	array_append(vals, 0);
+	tassert(!(array_meta(vals)->mode & ARRAY_MAPPED_));
+
+	for(i = 1; i < 100000; i++) {
+		array_append(vals, i);
+		array_append(heap, i);
+	}
+	tassert(!ARRAY_HAS_MMAP_ || (array_meta(vals)->mode & ARRAY_MAPPED_));
+	tassert(!(array_meta(heap)->mode & ARRAY_MAPPED_));
+
+	// contents survive the move into the mapping and every remap after
+	tassert(array_len(vals) == 100000);
+	for(i = 0; i < 100000; i++) tassert(vals[i] == i);
+
+	// switching back only affects arrays that are not mapped yet
+	array_set_mode(vals, ARRAY_MODE_HEAP);
+	array_reserve(vals, 1000000);
+	tassert(!ARRAY_HAS_MMAP_ || (array_meta(vals)->mode & ARRAY_MAPPED_));
+	tassert(vals[99999] == 99999);
+
+	array_free(vals);
+	array_free(heap);
+
+	return 0;
+}
+
+int test_array_aligned() {
+	int i, j;
+	double *vals;
+	size_t aligns[] = {16, 32, 64, 4096};
+
+	for(i = 0; i < 4; i++) {
+		array_new_aligned(&vals, double, aligns[i]);
+		tassert((uintptr_t) vals % aligns[i] == 0);
+
+		// every reallocation keeps the alignment and the contents
+		for(j = 0; j < 5000; j++) {
+			array_append(vals, j);
+			tassert((uintptr_t) vals % aligns[i] == 0);
+		}
+		for(j = 0; j < 5000; j++) tassert(vals[j] == j);
+
+		array_free(vals);
+	}
+
+	// the same goes for arrays that move into a mapping
+	array_new_aligned(&vals, double, 64);
+	array_set_mode(vals, ARRAY_MODE_MMAP);
+	for(j = 0; j < 100000; j++) array_append(vals, j);
+	tassert(!ARRAY_HAS_MMAP_ || (array_meta(vals)->mode & ARRAY_MAPPED_));
+	tassert((uintptr_t) vals % 64 == 0);
+	for(j = 0; j < 100000; j++) tassert(vals[j] == j);
+	array_free(vals);
+
+	return 0;
+}
+
+/* Kernel functions of every level the CPU supports, plain loops first */
+#if ARRAY_HAS_SIMD_
+#define KERNEL_LEVELS (__builtin_cpu_supports("avx2") ? 3 : 2)
+#define KERNELS(OP) {array_##OP##_scalar_, array_##OP##_sse2_, \
+		array_##OP##_avx2_}
+#else
+#define KERNEL_LEVELS 1
+#define KERNELS(OP) {array_##OP##_scalar_}
+#endif
+
+/* Checks the array kernels of every level against plain loops for arrays of
+ * type T, using SUM_T to add up the elements.
+ */
+#define CHECK_KERNELS(NAME, T, SUM_T) \
+static int check_kernels_##NAME() {\
+	int l;\
+	size_t i, n, idx, count;\
+	SUM_T sum, expected_sum;\
+	T v, *vals, lo, hi, expected_lo, expected_hi;\
+	size_t (*finds[])(const void*, size_t, size_t, int, uint64_t, double) = \
+			KERNELS(find);\
+	size_t (*counts[])(const void*, size_t, size_t, int, uint64_t, double) = \
+			KERNELS(count);\
+	void (*sums[])(const void*, size_t, size_t, int, void*) = KERNELS(sum);\
+	void (*minmaxes[])(const void*, size_t, size_t, int, void*, void*) = \
+			KERNELS(minmax);\
+	void (*fills[])(void*, size_t, size_t, int, uint64_t, double) = \
+			KERNELS(fill);\
+\
+	for(n = 0; n < 6000; n = n < 70 ? n + 1 : n < 300 ? n + 37 : n * 4) {\
+		array_new(&vals, T);\
+		idx = n;\
+		count = 0;\
+		expected_sum = 0;\
+		expected_lo = expected_hi = 0;\
+		for(i = 0; i < n; i++) {\
+			v = (T) ((int) ((i * 37 + n) % 23) - 5);\
+			array_append(vals, v);\
+			if(v == 3 && idx == n) idx = i;\
+			count += v == 3;\
+			expected_sum += v;\
+			if(!i || v < expected_lo) expected_lo = v;\
+			if(!i || v > expected_hi) expected_hi = v;\
+		}\
+\
+		tassert(array_find(vals, 3) == idx);\
+		tassert(array_find(vals, 100) == n);\
+		tassert(array_count(vals, 3) == count);\
+		array_sum(vals, &sum);\
+		tassert(sum == expected_sum);\
+		if(n) {\
+			array_minmax(vals, &lo, &hi);\
+			tassert(lo == expected_lo && hi == expected_hi);\
+		}\
+\
+		for(l = 0; l < KERNEL_LEVELS; l++) {\
+			tassert(finds[l](vals, n, sizeof(T), array_kind_(vals), \
+					array_bits_(vals, 3), array_real_(vals, 3)) == idx);\
+			tassert(counts[l](vals, n, sizeof(T), array_kind_(vals), \
+					array_bits_(vals, 3), array_real_(vals, 3)) == count);\
+			if(array_kind_(vals) != ARRAY_KIND_FLOAT_) {\
+				uint64_t isum;\
+				sums[l](vals, n, sizeof(T), array_kind_(vals), &isum);\
+				tassert((SUM_T) isum == expected_sum);\
+			}\
+			if(n) {\
+				minmaxes[l](vals, n, sizeof(T), array_kind_(vals), \
+						&lo, &hi);\
+				tassert(lo == expected_lo && hi == expected_hi);\
+			}\
+		}\
+		for(l = 0; l < KERNEL_LEVELS; l++) {\
+			fills[l](vals, n, sizeof(T), array_kind_(vals), \
+					array_bits_(vals, l), array_real_(vals, l));\
+			for(i = 0; i < n; i++) tassert(vals[i] == (T) l);\
+		}\
+\
+		array_fill(vals, 9);\
+		for(i = 0; i < n; i++) tassert(vals[i] == 9);\
+\
+		array_free(vals);\
+	}\
+\
+	return 0;\
+}
+
+CHECK_KERNELS(u8, uint8_t, uint64_t)
+CHECK_KERNELS(i8, int8_t, int64_t)
+CHECK_KERNELS(u16, uint16_t, uint64_t)
+CHECK_KERNELS(i16, int16_t, int64_t)
+CHECK_KERNELS(u32, uint32_t, uint64_t)
+CHECK_KERNELS(i32, int32_t, int64_t)
+CHECK_KERNELS(u64, uint64_t, uint64_t)
+CHECK_KERNELS(i64, int64_t, int64_t)
+CHECK_KERNELS(f32, float, double)
+CHECK_KERNELS(f64, double, double)
+
+int test_array_kernels() {
+	tassert(check_kernels_u8() == 0);
+	tassert(check_kernels_i8() == 0);
+	tassert(check_kernels_u16() == 0);
+	tassert(check_kernels_i16() == 0);
+	tassert(check_kernels_u32() == 0);
+	tassert(check_kernels_i32() == 0);
+	tassert(check_kernels_u64() == 0);
+	tassert(check_kernels_i64() == 0);
+	tassert(check_kernels_f32() == 0);
+	tassert(check_kernels_f64() == 0);
+
+	return 0;
+}
+
+int test_ring_push_pop() {
+	int i, *ring;
+
+	ring_new(&ring, int, 5);
+	tassert(ring_capacity(ring) == 8);
+	tassert(ring_is_empty(ring));
+
+	// walk the ring around its end a few times
+	for(i = 0; i < 20; i++) {
+		ring_push_back(ring, i);
+		tassert(ring_pop_front(ring) == i);
+	}
+	ring_push_back(ring, 119);
+	tassert(ring_len(ring) == 1);
+	tassert(ring_front(ring) == 119);
+	tassert(ring_capacity(ring) == 8);
+
+	ring_push_front(ring, 7);
+	ring_push_front(ring, 6);
+	ring_push_back(ring, 8);
+	tassert(ring_len(ring) == 4);
+	tassert(ring_at(ring, 0) == 6);
+	tassert(ring_at(ring, 1) == 7);
+	tassert(ring_at(ring, 2) == 119);
+	tassert(ring_back(ring) == 8);
+
+	tassert(ring_pop_back(ring) == 8);
+	tassert(ring_pop_back(ring) == 119);
+	tassert(ring_pop_front(ring) == 6);
+	tassert(ring_pop_back(ring) == 7);
+	tassert(ring_is_empty(ring));
+
+	// fixed size window
+	for(i = 0; i < 100; i++) {
+		if(ring_is_full(ring)) ring_remove_front(ring);
+		ring_push_back(ring, i);
+	}
+	tassert(ring_capacity(ring) == 8);
+	for(i = 0; i < 8; i++) tassert(ring_at(ring, i) == 92 + i);
+
+	ring_clear(ring);
+	tassert(ring_is_empty(ring));
+
+	ring_free(ring);
+
+	return 0;
+}
+
+int test_ring_growth() {
+	int i, j, *ring;
+	double *aligned;
+
+	// wrapped contents ending up behind the old end or moved to the new end
+	for(j = 1; j < 8; j++) {
+		ring_new(&ring, int, 8);
+		for(i = 0; i < j; i++) ring_push_back(ring, -1);
+		for(i = 0; i < j; i++) ring_remove_front(ring);
+		for(i = 0; i < 8; i++) ring_push_back(ring, i);
+		tassert(ring_is_full(ring));
+
+		ring_push_back(ring, 8);
+		tassert(ring_capacity(ring) == 16);
+		tassert(ring_len(ring) == 9);
+		for(i = 0; i < 9; i++) tassert(ring_at(ring, i) == i);
+
+		ring_free(ring);
+	}
+
+	// growing at the front
+	ring_new(&ring, int, 2);
+	for(i = 0; i < 100; i++) ring_push_front(ring, i);
+	tassert(ring_capacity(ring) == 128);
+	for(i = 0; i < 100; i++) tassert(ring_at(ring, i) == 99 - i);
+	ring_reserve(ring, 1000);
+	tassert(ring_capacity(ring) == 1024);
+	for(i = 0; i < 100; i++) tassert(ring_pop_back(ring) == i);
+	ring_free(ring);
+
+	// aligned ring buffers keep wrapped contents when they are moved
+	array_new_aligned(&aligned, double, 64);
+	aligned = (double*) ring_grow_(aligned, 4);
+	for(i = 0; i < 3; i++) ring_push_back(aligned, -1);
+	for(i = 0; i < 3; i++) ring_remove_front(aligned);
+	for(i = 0; i < 100; i++) {
+		ring_push_back(aligned, i);
+		tassert((uintptr_t) aligned % 64 == 0);
+	}
+	for(i = 0; i < 100; i++) tassert(ring_at(aligned, i) == i);
+	ring_free(aligned);
+
+	return 0;
+}
+
+int test_ring_iteration() {
+	int i, *ring, *value;
+
+	ring_new(&ring, int, 4);
+
+	i = 0;
+	ring_foreach(ring, value) i++;
+	tassert(i == 0);
+
+	// wrap the contents around the end
+	ring_push_back(ring, 0);
+	ring_push_back(ring, 0);
+	ring_remove_front(ring);
+	ring_remove_front(ring);
+	for(i = 0; i < 4; i++) ring_push_back(ring, i);
+	tassert(&ring_front(ring) > &ring_back(ring));
+
+	i = 0;
+	ring_foreach(ring, value) {
+		tassert(*value == i);
+		i++;
+	}
+	tassert(i == 4);
+
+	ring_foreach_reverse(ring, value) {
+		i--;
+		tassert(*value == i);
+	}
+	tassert(i == 0);
+
+	ring_free(ring);
+
+	return 0;
+}
+
+int test_ring_bounded() {
+	int i, *ring;
+
+	ring_new(&ring, int, 4);
+	tassert(ring != NULL);
+
+	// wrap the ring around its end before filling it
+	ring_push_back(ring, 0);
+	ring_remove_front(ring);
+	for(i = 0; i < 4; i++) tassert(ring_try_push_back(ring, i) == 0);
+	tassert(ring_try_push_back(ring, 4) == -1);
+	tassert(ring_try_push_front(ring, -1) == -1);
+	tassert(ring_len(ring) == 4 && ring_capacity(ring) == 4);
+	for(i = 0; i < 4; i++) tassert(ring_at(ring, i) == i);
+
+	ring_remove_back(ring);
+	tassert(ring_try_push_front(ring, -1) == 0);
+	tassert(ring_front(ring) == -1 && ring_back(ring) == 2);
+
+	// a sliding window over the last four values
+	for(i = 0; i < 10; i++) ring_push_back_overwrite(ring, i);
+	tassert(ring_len(ring) == 4 && ring_capacity(ring) == 4);
+	for(i = 0; i < 4; i++) tassert(ring_at(ring, i) == 6 + i);
+
+	ring_push_front_overwrite(ring, 5);
+	tassert(ring_len(ring) == 4 && ring_capacity(ring) == 4);
+	for(i = 0; i < 4; i++) tassert(ring_at(ring, i) == 5 + i);
+
+	ring_free(ring);
+
+	// running out of memory while creating the ring
+	test_alloc_limit = 128;
+	ring = &i;
+	ring_new(&ring, int, 1024);
+	tassert(ring == NULL);
+	test_alloc_limit = 0;
+
+	return 0;
+}
+
+/* Counts the visits of a node and the total amount of visits in CTX */
+void visit_qelement(void *item, void *ctx) {
+	((struct qelement*) item)->seq++;
+	__atomic_fetch_add((long*) ctx, 1, __ATOMIC_RELAXED);
+}
+
+void visit_int(void *item, void *ctx) {
+	*(int*) item *= 2;
+	__atomic_fetch_add((long*) ctx, 1, __ATOMIC_RELAXED);
+}
+
+int test_parallel_foreach_list() {
+	int i, j, sizes[] = {0, 1, 1000, 20000}, threads[] = {1, 3, 8, 0};
+	long visits;
+	struct qelement *list, *nodes, *node;
+
+	for(i = 0; i < 4; i++) {
+		for(j = 0; j < 4; j++) {
+			list = NULL;
+			nodes = calloc(sizes[i] + 1, sizeof(struct qelement));
+			for(node = nodes; node < nodes + sizes[i]; node++) {
+				list_append(&list, node);
+			}
+
+			visits = 0;
+			list_parallel_foreach(&list, visit_qelement, &visits, threads[j]);
+			tassert(visits == sizes[i]);
+
+			// every node exactly once, and the list is left alone
+			visits = 0;
+			list_foreach(&list, node) {
+				tassert(node->seq == 1);
+				tassert(node->next->prev == node);
+				tassert(node == nodes + visits);
+				visits++;
+			}
+			tassert(visits == sizes[i]);
+
+			free(nodes);
+		}
+	}
+
+	return 0;
+}
+
+int test_parallel_foreach_out_of_memory() {
+	int i, limits[] = {64, 512};
+	long visits;
+	struct qelement *list, *nodes, *node;
+
+	nodes = calloc(20000, sizeof(struct qelement));
+	list = NULL;
+	for(node = nodes; node < nodes + 20000; node++) list_append(&list, node);
+
+	// first no array for the chunks, then no workers for the threads
+	for(i = 0; i < 2; i++) {
+		test_alloc_limit = limits[i];
+		visits = 0;
+		list_parallel_foreach(&list, visit_qelement, &visits, 8);
+		test_alloc_limit = 0;
+		tassert(visits == 20000);
+		list_foreach(&list, node) tassert(node->seq == i + 1);
+	}
+
+	free(nodes);
+
+	return 0;
+}
+
+int test_parallel_foreach_array() {
+	int i, j, sizes[] = {0, 1, 1000, 100000}, threads[] = {1, 3, 8, 0};
+	int *vals;
+	long visits;
+
+	for(i = 0; i < 4; i++) {
+		for(j = 0; j < 4; j++) {
+			array_new(&vals, int);
+			array_append_n(vals, 1, sizes[i]);
+
+			visits = 0;
+			array_parallel_foreach(vals, visit_int, &visits, threads[j]);
+			tassert(visits == sizes[i]);
+			array_parallel_foreach(vals, visit_int, &visits, threads[j]);
+			tassert(visits == 2 * sizes[i]);
+			tassert(array_count(vals, 4) == (size_t) sizes[i]);
+
+			array_free(vals);
+		}
+	}
+
+	return 0;
+}
+
+/* Checks order, links and levels of a skip list with N nodes */
+int check_skiplist(struct snodes *s, int n) {
+	int i;
+	size_t level;
+	struct snode *node, *last;
+
+	tassert(snodes_len(s) == (size_t) n);
+
+	// sorted, with equal keys in the order they were inserted
+	i = 0;
+	last = NULL;
+	list_foreach(&s->list, node) {
+		tassert(node->next->prev == node);
+		tassert(node->prev->next == node);
+		tassert(!last || last->key < node->key ||
+				(last->key == node->key && last->seq < node->seq));
+		last = node;
+		i++;
+	}
+	tassert(i == n);
+
+	list_foreach_reverse(&s->list, node) i--;
+	tassert(i == 0);
+
+	for(level = 0; level < 4; level++) {
+		last = NULL;
+		for(node = s->top[level]; node; node = node->skip[level]) {
+			tassert(!last || last->key <= node->key);
+			last = node;
+		}
+	}
+
+	return 0;
+}
+
+int test_skiplist() {
+	int i, k;
+	unsigned seed;
+	struct snodes s = {0};
+	struct snode *nodes, *node, *expected, key;
+
+	nodes = calloc(2000, sizeof(struct snode));
+	seed = 1;
+	for(i = 0; i < 2000; i++) {
+		seed = seed * 1103515245 + 12345;
+		nodes[i].key = (seed >> 16) % 500;
+		nodes[i].seq = i;
+		snodes_insert(&s, nodes + i);
+	}
+	tassert(check_skiplist(&s, 2000) == 0);
+	tassert(s.top[0] != NULL);
+
+	for(k = -1; k <= 501; k++) {
+		key.key = k;
+		expected = NULL;
+		list_foreach(&s.list, node) {
+			if(node->key >= k) {
+				expected = node;
+				break;
+			}
+		}
+		tassert(snodes_lower_bound(&s, &key) == expected);
+		tassert(snodes_find(&s, &key) ==
+				(expected && expected->key == k ? expected : NULL));
+	}
+
+	// remove every other node, many of them among equal keys
+	for(i = 1; i < 2000; i += 2) snodes_remove(&s, nodes + i);
+	tassert(check_skiplist(&s, 1000) == 0);
+
+	for(i = 0; i < 2000; i += 2) snodes_remove(&s, nodes + i);
+	tassert(check_skiplist(&s, 0) == 0);
+	tassert(s.list == NULL);
+	for(i = 0; i < 4; i++) tassert(s.top[i] == NULL);
+
+	free(nodes);
+
+	return 0;
+}
+
+int test_skiplist_range() {
+	int i, count;
+	struct snodes s = {0};
+	struct snode *nodes, *node, key;
+
+	nodes = calloc(300, sizeof(struct snode));
+	for(i = 0; i < 300; i++) {
+		nodes[i].key = (i * 7) % 300;
+		nodes[i].seq = i;
+		snodes_insert(&s, nodes + i);
+	}
+
+	// all keys from 100 to 199
+	key.key = 100;
+	count = 0;
+	list_foreach_from(&s.list, node, snodes_lower_bound(&s, &key)) {
+		if(node->key >= 200) break;
+		tassert(node->key == 100 + count);
+		count++;
+	}
+	tassert(count == 100);
+
+	// ranges starting behind the last node are empty
+	key.key = 300;
+	count = 0;
+	list_foreach_from(&s.list, node, snodes_lower_bound(&s, &key)) count++;
+	tassert(count == 0);
+
+	free(nodes);
+
+	return 0;
+}
+
+/* Checks the heap property of a D-ary heap of ints */
+int check_heap(int *h, size_t d) {
+	size_t i;
+
+	for(i = 1; i < array_len(h); i++) tassert(h[(i - 1) / d] <= h[i]);
+
+	return 0;
+}
+
+int test_heap() {
+	int i, last, *h2, *h4;
+	unsigned seed;
+
+	array_new(&h2, int);
+	array_new(&h4, int);
+
+	seed = 7;
+	for(i = 0; i < 1000; i++) {
+		seed = seed * 1103515245 + 12345;
+		heap2_push(&h2, (seed >> 16) % 300);
+		heap4_push(&h4, (seed >> 16) % 300);
+	}
+	tassert(heap2_len(h2) == 1000);
+	tassert(check_heap(h2, 2) == 0);
+	tassert(check_heap(h4, 4) == 0);
+	tassert(heap2_top(h2) == heap4_top(h4));
+
+	for(i = 0, last = -1; i < 1000; i++) {
+		tassert(heap2_top(h2) >= last);
+		last = heap2_pop(&h2);
+		tassert(heap4_pop(&h4) == last);
+	}
+	tassert(heap2_len(h2) == 0);
+
+	// heapify arrays of every small size and a large one
+	for(i = 0; i < 40; i++) {
+		array_append(h2, 1000 - i * 7 % 13);
+		array_append(h4, 1000 - i * 7 % 13);
+		heap2_heapify(h2);
+		heap4_heapify(h4);
+		tassert(check_heap(h2, 2) == 0);
+		tassert(check_heap(h4, 4) == 0);
+	}
+	for(i = 0; i < 5000; i++) array_append(h4, (i * 7919) % 5000);
+	heap4_heapify(h4);
+	tassert(check_heap(h4, 4) == 0);
+	for(i = 0, last = -1; heap4_len(h4); i++) {
+		tassert(heap4_top(h4) >= last);
+		last = heap4_pop(&h4);
+	}
+
+	array_free(h2);
+	array_free(h4);
+
+	return 0;
+}
+
+int test_heap_decrease_key() {
+	int i, last;
+	struct job *h, job;
+
+	array_new(&h, struct job);
+
+	for(i = 0; i < 1000; i++) {
+		job.prio = 1000 + (i * 7919) % 1000;
+		job.id = i;
+		array_append(h, job);
+	}
+	jobs_heapify(h);
+	for(i = 0; i < 1000; i++) tassert(h[job_pos[i]].id == i);
+
+	// give every third job a higher priority
+	for(i = 0; i < 1000; i += 3) {
+		job = h[job_pos[i]];
+		job.prio -= 1000;
+		jobs_decrease_key(h, job_pos[i], job);
+		tassert(h[job_pos[i]].id == i);
+	}
+	for(i = 0; i < 1000; i++) tassert(h[job_pos[i]].id == i);
+
+	for(i = 0, last = -1000; i < 1000; i++) {
+		job = jobs_pop(&h);
+		tassert(job.prio >= last);
+		tassert((job.id % 3 == 0) == (job.prio < 1000));
+		last = job.prio;
+	}
+
+	array_free(h);
+
+	return 0;
+}
+
+/* Checks that the nodes of the cache are in this order and all can be found */
+int check_cache(struct bad_cache *c, int *keys, int n) {
+	struct centry *e, key;
+	int i;
+
+	tassert(bad_cache_len(c) == (size_t) n);
+	i = 0;
+	list_foreach(&c->list, e) {
+		tassert(i < n && e->key == keys[i]);
+		i++;
+	}
+	tassert(i == n);
+	for(i = 0; i < n; i++) {
+		key.key = keys[i];
+		tassert(c->slots[bad_cache_slot_(c, &key)]->key == keys[i]);
+	}
+
+	return 0;
+}
+
+int test_lru() {
+	struct cache c;
+	struct centry entries[5], other, key, *e;
+	int i;
+
+	cache_init(&c, 3);
+	for(i = 0; i < 5; i++) entries[i].key = i;
+
+	key.key = 0;
+	tassert(cache_get(&c, &key) == NULL);
+	tassert(cache_evict(&c) == NULL);
+
+	for(i = 0; i < 3; i++) tassert(cache_put(&c, &entries[i]) == NULL);
+	tassert(cache_len(&c) == 3);
+	tassert(c.list == &entries[2]);
+
+	// using 0 makes 1 the least recently used entry
+	tassert(cache_get(&c, &key) == &entries[0]);
+	tassert(c.list == &entries[0]);
+	tassert(cache_put(&c, &entries[3]) == &entries[1]);
+	key.key = 1;
+	tassert(cache_get(&c, &key) == NULL);
+
+	// putting the same node again only moves it to the front
+	tassert(cache_put(&c, &entries[2]) == NULL);
+	tassert(c.list == &entries[2] && c.list->prev == &entries[0]);
+	cache_touch(&c, &entries[0]);
+	tassert(c.list == &entries[0] && c.list->prev == &entries[3]);
+
+	// a new node with the same key replaces the old one
+	other.key = 3;
+	tassert(cache_put(&c, &other) == &entries[3]);
+	key.key = 3;
+	tassert(cache_get(&c, &key) == &other);
+	tassert(cache_len(&c) == 3);
+
+	cache_remove(&c, &entries[0]);
+	tassert(cache_put(&c, &entries[4]) == NULL);
+	tassert((e = cache_evict(&c)) == &entries[2]);
+	tassert(cache_len(&c) == 2);
+
+	tassert(c.hits == 2 && c.misses == 2 && c.evictions == 2);
+
+	cache_free(&c);
+
+	return 0;
+}
+
+int test_lru_collisions() {
+	struct bad_cache c;
+	struct centry entries[64], key, *e;
+	int order[64], i, j, k, n;
+	unsigned r;
+
+	bad_cache_init(&c, 16);
+	for(i = 0; i < 64; i++) entries[i].key = i;
+
+	n = 0;
+	r = 1;
+	for(i = 0; i < 2000; i++) {
+		// mostly keys from 0 to 23 so some of them stay in the cache
+		r = r * 1103515245 + 12345;
+		k = (r >> 16) % (i % 8 ? 24 : 64);
+		key.key = k;
+		for(j = 0; j < n && order[j] != k; j++);
+
+		if(i % 5 == 4 && j < n) {
+			bad_cache_remove(&c, &entries[k]);
+			memmove(&order[j], &order[j + 1], (n - j - 1) * sizeof(int));
+			n--;
+		}
+		else if((e = bad_cache_get(&c, &key))) {
+			tassert(j < n && e == &entries[k]);
+			memmove(&order[1], &order[0], j * sizeof(int));
+			order[0] = k;
+		}
+		else {
+			tassert(j == n);
+			e = bad_cache_put(&c, &entries[k]);
+			if(n == 16) {
+				tassert(e == &entries[order[15]]);
+				n--;
+			}
+			else {
+				tassert(e == NULL);
+			}
+			memmove(&order[1], &order[0], n * sizeof(int));
+			order[0] = k;
+			n++;
+		}
+		if(check_cache(&c, order, n)) return 1;
+	}
+
+	tassert(c.hits > 0 && c.misses > 0 && c.evictions > 0);
+	bad_cache_free(&c);
+
+	return 0;
+}
+
+/* Takes the expired timers out of EXPIRED and checks that they are in order
+ * and all of them expire at NOW or earlier, returns -1 if not
+ */
+int take_expired(struct timer **expired, uint64_t now) {
+	struct timer *t, *tmp;
+	uint64_t last;
+	int n;
+
+	n = 0;
+	last = 0;
+	list_foreach_safe(expired, t, tmp) {
+		if(!t->armed || t->expires > now || t->expires < last) return -1;
+		last = t->expires;
+		t->armed = 0;
+		list_remove(expired, t);
+		n++;
+	}
+
+	return n;
+}
+
+int test_timer_wheel() {
+	struct timers w;
+	struct timer t[7] = {{0}}, *expired;
+	uint64_t when[] = {5, 5, 63, 64, 100, 5000, (uint64_t) 1 << 30};
+	int i;
+
+	timers_init(&w, 0);
+	tassert(timers_is_empty(&w));
+	for(i = 0; i < 7; i++) {
+		timers_schedule(&w, &t[i], when[i]);
+		t[i].armed = 1;
+	}
+	tassert(!timers_is_empty(&w));
+
+	expired = NULL;
+	timers_advance(&w, 4, &expired);
+	tassert(expired == NULL);
+	timers_advance(&w, 5, &expired);
+	tassert(expired == &t[0] && expired->next == &t[1]);
+	tassert(take_expired(&expired, 5) == 2);
+
+	// cancelling expired timers, before and after they were taken out of
+	// the list, and cancelling twice leaves the wheel alone
+	timers_advance(&w, 63, &expired);
+	tassert(expired == &t[2]);
+	tassert(timers_cancel(&w, &t[2]) == 0);
+	tassert(expired == &t[2] && expired->next == &t[2]);
+	tassert(take_expired(&expired, 63) == 1);
+	tassert(timers_cancel(&w, &t[0]) == 0);
+	tassert(timers_cancel(&w, &t[4]) == 1);
+	t[4].armed = 0;
+	tassert(timers_cancel(&w, &t[4]) == 0);
+	timers_advance(&w, 70000, &expired);
+	tassert(expired == &t[3]);
+	tassert(take_expired(&expired, 70000) == 2);
+
+	// a timer in the past expires right away
+	timers_schedule(&w, &t[0], 10);
+	t[0].armed = 1;
+	tassert(t[0].expires == 70001);
+	timers_advance(&w, 70001, &expired);
+	tassert(expired == &t[0]);
+	tassert(take_expired(&expired, 70001) == 1);
+
+	tassert(!timers_is_empty(&w));
+	timers_advance(&w, ((uint64_t) 1 << 30) - 1, &expired);
+	tassert(expired == NULL);
+	timers_advance(&w, (uint64_t) 1 << 30, &expired);
+	tassert(expired == &t[6]);
+	tassert(take_expired(&expired, (uint64_t) 1 << 30) == 1);
+	tassert(timers_is_empty(&w));
+
+	timers_free(&w);
+
+	return 0;
+}
+
+int test_timer_wheel_random() {
+	struct timers w;
+	struct timer t[200], *expired;
+	uint64_t now, r, scale[] = {64, 4096, 1 << 20, 1 << 27};
+	int i, k, n, armed;
+
+	now = 123456789;
+	timers_init(&w, now);
+	// zeroed, so cancelling a timer never scheduled does nothing
+	memset(t, 0, sizeof(t));
+	expired = NULL;
+	armed = 0;
+	r = 1;
+
+	for(i = 0; i < 20000; i++) {
+		r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+		k = (r >> 33) % 200;
+		if(i % 4 == 3) {
+			now += (r >> 40) % scale[(r >> 20) % 4];
+			timers_advance(&w, now, &expired);
+			n = take_expired(&expired, now);
+			tassert(n >= 0);
+			armed -= n;
+			for(k = 0; k < 200; k++) tassert(!t[k].armed || t[k].expires > now);
+		}
+		else if(t[k].armed) {
+			tassert(timers_cancel(&w, &t[k]) == 1);
+			t[k].armed = 0;
+			armed--;
+		}
+		else {
+			tassert(timers_cancel(&w, &t[k]) == 0);
+			timers_schedule(&w, &t[k], now + (r >> 40) % scale[(r >> 20) % 4]);
+			t[k].armed = 1;
+			armed++;
+		}
+		tassert(timers_is_empty(&w) == (armed == 0));
+	}
+
+	timers_free(&w);
+
+	return 0;
+}
+
+/* Nodes passed to element_moved that weren't where the table said */
+int moved_errors;
+
+/* Keeps the table of nodes by id in CTX pointing at the copies */
+void element_moved(void *from, void *to, void *ctx) {
+	struct element **by_id = ctx;
+
+	if(by_id[(int) ((struct element*) from)->id] != from) moved_errors++;
+	by_id[(int) ((struct element*) to)->id] = to;
+	free(from);
+}
+
+int test_list_compact() {
+	struct element *list, *by_id[20], *node, *e;
+	struct list_pool *pool;
+	int i;
+
+	list = NULL;
+	tassert(list_compact(&list, sizeof(struct element), NULL, NULL) == NULL);
+
+	// every other node goes to the front, so the nodes aren't in order
+	for(i = 0; i < 20; i++) {
+		by_id[i] = create_element(i);
+		if(i % 2) {
+			list_append(&list, by_id[i]);
+		}
+		else {
+			list_prepend(&list, by_id[i]);
+		}
+	}
+
+	moved_errors = 0;
+	pool = list_compact(&list, sizeof(struct element), element_moved, by_id);
+	tassert(pool != NULL);
+	tassert(moved_errors == 0);
+	tassert(check_links(&list, 20) == 0);
+
+	i = 0;
+	list_foreach(&list, node) {
+		tassert(node->id == (i < 10 ? 18 - 2 * i : 2 * i - 19));
+		tassert(by_id[(int) node->id] == node);
+		tassert(node == list || node == node->prev + 1);
+		i++;
+	}
+
+	// the pool works as usual afterwards
+	e = by_id[7];
+	list_remove(&list, e);
+	list_pool_release(pool, e);
+	tassert(list_pool_alloc(pool) == e);
+	tassert(check_links(&list, 19) == 0);
+
+	list_pool_free_list(&list, pool);
+
+	return 0;
+}
+
+/* Path of a temporary file for the tests saving arrays */
+const char *array_test_path() {
+	static char path[64];
+
+	snprintf(path, sizeof(path), "/tmp/list_h_test_%d.bin", (int) getpid());
+
+	return path;
+}
+
+int test_array_save_map() {
+	int *values, *mapped, *ring, i;
+	double *aligned, *mapped_aligned;
+	const char *path = array_test_path();
+
+	array_new(&values, int);
+	for(i = 0; i < 10000; i++) array_append(values, i * 3);
+	tassert(array_save(values, path) == 0);
+
+	tassert(array_map(&mapped, int, path, ARRAY_MAP_READ_ONLY) == 0);
+	tassert(array_len(mapped) == 10000);
+	tassert(memcmp(mapped, values, 10000 * sizeof(int)) == 0);
+	tassert((uintptr_t) mapped % 64 == 0);
+
+	// growing moves the array out of the file
+	array_append(mapped, -1);
+	tassert(array_len(mapped) == 10001 && mapped[10000] == -1);
+	tassert(mapped[9999] == 9999 * 3);
+	tassert(!(array_meta(mapped)->mode & ARRAY_MAPPED_));
+	array_free(mapped);
+
+	// changes to a private mapping stay private
+	tassert(array_map(&mapped, int, path, ARRAY_MAP_PRIVATE) == 0);
+	mapped[5] = -5;
+	array_free(mapped);
+	tassert(array_map(&mapped, int, path, ARRAY_MAP_READ_ONLY) == 0);
+	tassert(mapped[5] == 15);
+	array_free(mapped);
+
+	// ring buffers are saved in order
+	ring_new(&ring, int, 8);
+	for(i = 0; i < 6; i++) ring_push_back(ring, i);
+	for(i = 0; i < 4; i++) ring_remove_front(ring);
+	for(i = 6; i < 12; i++) ring_push_back(ring, i);
+	tassert(array_save(ring, path) == 0);
+	tassert(array_map(&mapped, int, path, ARRAY_MAP_READ_ONLY) == 0);
+	tassert(array_len(mapped) == 8);
+	for(i = 0; i < 8; i++) tassert(mapped[i] == i + 4);
+	array_free(mapped);
+	ring_free(ring);
+
+	array_new_aligned(&aligned, double, 4096);
+	for(i = 0; i < 100; i++) array_append(aligned, i / 2.0);
+	tassert(array_save(aligned, path) == 0);
+	tassert(array_map(&mapped_aligned, double, path, ARRAY_MAP_PRIVATE) == 0);
+	tassert((uintptr_t) mapped_aligned % 4096 == 0);
+	tassert(mapped_aligned[99] == 49.5);
+	array_free(mapped_aligned);
+	array_free(aligned);
+
+	array_free(values);
+	unlink(path);
+
+	return 0;
+}
+
+int test_array_map_errors() {
+	int *values, *mapped;
+	long *longs;
+	const char *path = array_test_path();
+	FILE *f;
+
+	unlink(path);
+	mapped = values = NULL;
+	tassert(array_map(&mapped, int, path, ARRAY_MAP_READ_ONLY) == -1);
+	tassert(mapped == NULL);
+
+	array_new(&values, int);
+	array_append_n(values, 7, 1000);
+	tassert(array_save(values, path) == 0);
+	tassert(array_map(&longs, long, path, ARRAY_MAP_READ_ONLY) == -1);
+
+	// a file that was cut short
+	tassert(truncate(path, 1000) == 0);
+	tassert(array_map(&mapped, int, path, ARRAY_MAP_READ_ONLY) == -1);
+
+	f = fopen(path, "w");
+	tassert(f != NULL);
+	fputs("not an array", f);
+	fclose(f);
+	tassert(array_map(&mapped, int, path, ARRAY_MAP_READ_ONLY) == -1);
+
+	tassert(array_save(values, "/nonexistent/dir/file") == -1);
+
+	array_free(values);
+	unlink(path);
+
+	return 0;
+}
+
+int test_ring_save_map() {
+	int *ring, *mapped, i;
+	const char *path = array_test_path();
+
+	// five elements wrapping around the end of a ring of eight
+	ring_new(&ring, int, 8);
+	for(i = 0; i < 6; i++) ring_push_back(ring, 0);
+	for(i = 0; i < 6; i++) ring_remove_front(ring);
+	for(i = 0; i < 5; i++) ring_push_back(ring, i);
+	tassert(&ring_front(ring) > &ring_back(ring));
+
+	// as an array the capacity is not a power of two
+	tassert(array_save(ring, path) == 0);
+	tassert(ring_map(&mapped, int, path, ARRAY_MAP_PRIVATE) == -1);
+	tassert(array_map(&mapped, int, path, ARRAY_MAP_READ_ONLY) == 0);
+	tassert(array_len(mapped) == 5 && array_allocated(mapped) == 5);
+	array_free(mapped);
+
+	tassert(ring_save(ring, path) == 0);
+	tassert(array_map(&mapped, int, path, ARRAY_MAP_READ_ONLY) == -1);
+	tassert(ring_map(&mapped, int, path, ARRAY_MAP_PRIVATE) == 0);
+	tassert(ring_len(mapped) == 5 && ring_capacity(mapped) == 8);
+	for(i = 0; i < 5; i++) tassert(ring_at(mapped, i) == i);
+
+	// walk the mapped ring around its end, then grow it onto the heap
+	for(i = 5; i < 20; i++) {
+		ring_push_back(mapped, i);
+		tassert(ring_pop_front(mapped) == i - 5);
+	}
+	tassert(ring_capacity(mapped) == 8);
+	ring_push_front(mapped, 14);
+	ring_push_back(mapped, 20);
+	ring_push_back(mapped, 21);
+	tassert(ring_is_full(mapped) && ring_capacity(mapped) == 8);
+	ring_push_back(mapped, 22);
+	tassert(ring_capacity(mapped) == 16);
+	tassert(!(array_meta(mapped)->mode & ARRAY_MAPPED_));
+	for(i = 0; i < 9; i++) tassert(ring_at(mapped, i) == 14 + i);
+	ring_free(mapped);
+
+	ring_free(ring);
+	unlink(path);
+
+	return 0;
+}
+
+int test_allocation_hooks() {
+	long allocs, frees;
+	int i, *values;
+	double *aligned;
+	struct list_pool *pool;
+	struct element *list, *node;
+	struct unrolled *unrolled_list;
+
+	allocs = test_allocs;
+	frees = test_frees;
+
+	pool = list_pool_new(struct element, 4);
+	tassert(pool != NULL);
+	list = NULL;
+	for(i = 0; i < 10; i++) {
+		node = (struct element*) list_pool_alloc(pool);
+		tassert(node != NULL && node->id == 0);
+		list_append(&list, node);
+	}
+	list_pool_free_list(&list, pool);
+	// the pool and its three chunks
+	tassert(test_allocs - allocs == 4);
+	tassert(test_frees - frees == 4);
+
+	unrolled_list = NULL;
+	for(i = 0; i < 100; i++) tassert(unrolled_append(&unrolled_list, i) == 0);
+	unrolled_free(&unrolled_list);
+
+	array_new(&values, int);
+	for(i = 0; i < 1000; i++) array_append(values, i);
+	array_free(values);
+
+	array_new_aligned(&aligned, double, 64);
+	for(i = 0; i < 1000; i++) array_append(aligned, i);
+	tassert((uintptr_t) aligned % 64 == 0);
+	array_free(aligned);
+
+	// 25 full unrolled nodes and the blocks of both arrays, reallocs not counted
+	tassert(test_allocs - allocs == 4 + 25 + 2);
+	tassert(test_allocs - allocs == test_frees - frees);
+
+	// a failing LIST_REALLOC keeps the array as it was
+	array_new(&values, int);
+	tassert(values != NULL);
+	array_append_n(values, 1, 100);
+	test_alloc_limit = 4096;
+	tassert(array_reserve_checked(values, 100000) == -1);
+	tassert(array_len(values) == 100 && array_allocated(values) < 100000);
+	tassert(values[0] == 1 && values[99] == 1);
+	tassert(array_reserve_checked(values, 200) == 0);
+	tassert(array_allocated(values) >= 200);
+	test_alloc_limit = 0;
+	tassert(array_reserve_checked(values, 100000) == 0);
+	tassert(array_allocated(values) >= 100000 && values[99] == 1);
+	array_free(values);
+
+	// as does creating an aligned array
+	test_alloc_limit = 64;
+	aligned = (double*) &i;
+	array_new_aligned(&aligned, double, 4096);
+	tassert(aligned == NULL);
+	test_alloc_limit = 0;
+
+	return 0;
+}
+
+/* Bump arena of test_array_allocator
+ *
+ * Blocks are never reused, LIVE counts the blocks that weren't freed yet.
+ */
+struct arena {
+	char *buf;
+	size_t size;
+	size_t used;
+	long calls;
+	long live;
+};
+
+void *arena_alloc(void *ctx, void *p, size_t old, size_t size) {
+	struct arena *a = (struct arena*) ctx;
+	char *n;
+
+	a->calls++;
+	if(!size) {
+		a->live--;
+		return NULL;
+	}
+	if(size > a->size - a->used) return NULL;
+
+	n = a->buf + a->used;
+	a->used += (size + 15) & ~(size_t) 15;
+	if(p) {
+		memcpy(n, p, old < size ? old : size);
+	}
+	else {
+		a->live++;
+	}
+
+	return n;
+}
+
+int arena_owns(struct arena *a, void *p) {
+	return (char*) p >= a->buf && (char*) p < a->buf + a->size;
+}
+
+int test_array_allocator() {
+	struct arena a = {0}, b = {0};
+	int *x, *y, *mapped, i;
+	const char *path = array_test_path();
+
+	a.size = b.size = 1 << 16;
+	a.buf = (char*) malloc(a.size);
+	b.buf = (char*) malloc(b.size);
+	tassert(a.buf && b.buf);
+
+	// two arrays in the same process with different arenas
+	array_new_allocator(&x, int, arena_alloc, &a);
+	array_new_allocator(&y, int, arena_alloc, &b);
+	tassert(array_len(x) == 0 && array_allocated(x) == 0);
+	for(i = 0; i < 1000; i++) {
+		array_append(x, i);
+		array_append(y, -i);
+	}
+	tassert(x[999] == 999 && y[999] == -999);
+	tassert(arena_owns(&a, array_meta(x)) && arena_owns(&b, array_meta(y)));
+	tassert(array_meta(x)->allocator_ctx == &a);
+	tassert(a.calls > 1 && a.calls == b.calls);
+	array_free(x);
+	array_free(y);
+	tassert(a.live == 0 && b.live == 0);
+
+	// running out of memory leaves the array as it was
+	a.used = 0;
+	array_new_allocator(&x, int, arena_alloc, &a);
+	tassert(x != NULL);
+	array_append_n(x, 7, 10);
+	tassert(array_reserve_checked(x, 1 << 20) == -1);
+	tassert(array_len(x) == 10 && array_allocated(x) < (1 << 20));
+	for(i = 0; i < 10; i++) tassert(x[i] == 7);
+	array_free(x);
+	tassert(a.live == 0);
+
+	// and creating an array reports it with a NULL array
+	a.used = a.size;
+	x = &i;
+	array_new_allocator(&x, int, arena_alloc, &a);
+	tassert(x == NULL);
+
+	// the allocator does not end up in saved files
+	a.used = 0;
+	array_new_allocator(&x, int, arena_alloc, &a);
+	for(i = 0; i < 100; i++) array_append(x, i);
+	tassert(array_save(x, path) == 0);
+	tassert(array_map(&mapped, int, path, ARRAY_MAP_READ_ONLY) == 0);
+	tassert(array_meta(mapped)->allocator == NULL);
+	array_append(mapped, 100);
+	tassert(!arena_owns(&a, array_meta(mapped)));
+	tassert(mapped[99] == 99 && mapped[100] == 100);
+	array_free(mapped);
+	array_free(x);
+	unlink(path);
+
+	free(a.buf);
+	free(b.buf);
+
+	return 0;
+}
+
+#ifdef LIST_STATS
+void *stats_thread(void *arg) {
+	struct element *list, *e;
+
+	list = NULL;
+	e = create_element('a');
+	list_append(&list, e);
+	list_remove(&list, e);
+	free(e);
+
+	return arg;
+}
+
+int test_stats() {
+	struct list_stats s;
+	struct element *list, *e, *node;
+	int *values, more[10], i;
+	pthread_t thread;
+
+	list_stats_reset();
+	list_stats_read(&s);
+	tassert(s.appends == 0 && s.steps == 0 && s.reallocs == 0);
+
+	list = NULL;
+	for(i = 0; i < 4; i++) {
+		e = create_element('a' + i);
+		list_append(&list, e);
+	}
+	e = create_element('e');
+	list_prepend(&list, e);
+	e = create_element('f');
+	list_insert_after(&list, e, list);
+	list_foreach(&list, node) {}
+	list_remove(&list, e);
+	free(e);
+
+	list_stats_read(&s);
+	tassert(s.appends == 4 && s.prepends == 1 && s.inserts == 1);
+	tassert(s.removes == 1 && s.steps == 6);
+
+	// the counters of threads that have exited are kept
+	tassert(pthread_create(&thread, NULL, stats_thread, NULL) == 0);
+	pthread_join(thread, NULL);
+	list_stats_read(&s);
+	tassert(s.appends == 5 && s.removes == 2);
+
+	// a thread that can't allocate its counters still works, uncounted
+	test_alloc_limit = 64;
+	tassert(pthread_create(&thread, NULL, stats_thread, NULL) == 0);
+	pthread_join(thread, NULL);
+	test_alloc_limit = 0;
+	list_stats_read(&s);
+	tassert(s.appends == 5 && s.removes == 2);
+
+	array_new(&values, int);
+	for(i = 0; i < 1000; i++) array_append(values, i);
+	for(i = 0; i < 10; i++) more[i] = 2000 + i;
+	array_insert_n(values, 0, more, 10);
+	tassert(array_len(values) == 1010);
+	for(i = 0; i < 10; i++) tassert(values[i] == 2000 + i);
+	for(i = 0; i < 1000; i++) tassert(values[10 + i] == i);
+	list_stats_read(&s);
+	tassert(s.reallocs == 8);
+	tassert(s.bytes_moved >= 1000 * sizeof(int));
+	tassert(s.peak_allocated >= s.allocated);
+	tassert(s.peak_allocated - s.allocated < 1000 * sizeof(int));
+	array_free(values);
+	list_stats_read(&s);
+	tassert(s.peak_allocated - s.allocated >= 1000 * sizeof(int));
+
+	list_foreach_safe(&list, node, e) {
+		list_remove(&list, node);
+		free(node);
+	}
+
+	return 0;
+}
+#endif
+
 int main() {
 	int i, num_tests, failures;
 
@@ -676,6 +3070,57 @@ int main() {
 		declare_test(test_insert_before),
 		declare_test(test_iteration_end),
 		declare_test(test_iteration_until),
+		declare_test(test_pool_reuse),
+		declare_test(test_pool_list),
+		declare_test(test_array_reserve),
+		declare_test(test_array_extend),
+		declare_test(test_array_insert_n),
+		declare_test(test_array_growth),
+		declare_test(test_array_mmap),
+		declare_test(test_array_aligned),
+		declare_test(test_array_kernels),
+		declare_test(test_ring_push_pop),
+		declare_test(test_ring_growth),
+		declare_test(test_ring_iteration),
+		declare_test(test_ring_bounded),
+		declare_test(test_define_list),
+		declare_test(test_define_array),
+		declare_test(test_sort),
+		declare_test(test_sort_large),
+		declare_test(test_merge_sorted),
+		declare_test(test_concat),
+		declare_test(test_splice_after),
+		declare_test(test_split),
+		declare_test(test_rotate),
+		declare_test(test_unrolled_append),
+		declare_test(test_unrolled_insert),
+		declare_test(test_unrolled_removal),
+		declare_test(test_ilist),
+		declare_test(test_ilist_release),
+		declare_test(test_mpsc_single),
+		declare_test(test_mpsc_threads),
+		declare_test(test_prefetch_iteration),
+		declare_test(test_prefetch_iteration_removal),
+		declare_test(test_parallel_foreach_list),
+		declare_test(test_parallel_foreach_array),
+		declare_test(test_parallel_foreach_out_of_memory),
+		declare_test(test_skiplist),
+		declare_test(test_skiplist_range),
+		declare_test(test_heap),
+		declare_test(test_heap_decrease_key),
+		declare_test(test_lru),
+		declare_test(test_lru_collisions),
+		declare_test(test_timer_wheel),
+		declare_test(test_timer_wheel_random),
+		declare_test(test_array_save_map),
+		declare_test(test_array_map_errors),
+		declare_test(test_ring_save_map),
+		declare_test(test_list_compact),
+		declare_test(test_allocation_hooks),
+		declare_test(test_array_allocator),
+#ifdef LIST_STATS
+		declare_test(test_stats),
+#endif
 	};
 
 	num_tests = sizeof(tests) / sizeof(struct test);
@@ -0,0 +1,507 @@
+/* Tests for list.hpp
+ *
+ * These tests ensure that the C++ wrappers behave like the list.h macros they
+ * wrap and work with the algorithms of the standard library.
+ *
+ * If a test functions returns a non-zero value, it is deemed as an error.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+
+// Allocations larger than test_alloc_limit fail, unless it is 0
+static size_t test_alloc_limit;
+
+static void *test_calloc(size_t n, size_t size) {
+	if(test_alloc_limit && n * size > test_alloc_limit) return nullptr;
+	return calloc(n, size);
+}
+
+static void *test_realloc(void *p, size_t size) {
+	if(test_alloc_limit && size > test_alloc_limit) return nullptr;
+	return realloc(p, size);
+}
+
+#define LIST_CALLOC(N, S) test_calloc(N, S)
+#define LIST_REALLOC(P, S) test_realloc(P, S)
+#include "list.hpp"
+
+using circularlist::circular_list;
+using circularlist::dyn_array;
+
+typedef int (*testfunc_t)();
+
+struct test {
+	const char *name;
+	testfunc_t func;
+};
+
+#define tassert(EVAL) if(!(EVAL)) {\
+	printf("\nERROR! %s:%d Assertion [%s] failed.\n",\
+			__FILE__, __LINE__, #EVAL);\
+	return 1;}
+
+#define declare_test(TEST) {#TEST, TEST}
+
+struct element {
+	element *next;
+	element *prev;
+	char id;
+};
+
+// Nodes with other link names, so the list can not fall back to the defaults
+struct link_element {
+	link_element *left;
+	link_element *right;
+	int value;
+};
+
+typedef circular_list<element> element_list;
+typedef circular_list<link_element, &link_element::right, &link_element::left>
+	link_list;
+
+static_assert(std::is_nothrow_move_constructible<element_list>::value,
+		"circular_list must be nothrow movable");
+static_assert(!std::is_copy_constructible<element_list>::value,
+		"circular_list must not be copyable");
+static_assert(std::is_nothrow_move_constructible<dyn_array<int> >::value,
+		"dyn_array must be nothrow movable");
+static_assert(std::is_same<
+		std::iterator_traits<element_list::iterator>::iterator_category,
+		std::bidirectional_iterator_tag>::value,
+		"circular_list iterators must be bidirectional");
+static_assert(std::is_same<
+		std::iterator_traits<dyn_array<int>::iterator>::iterator_category,
+		std::random_access_iterator_tag>::value,
+		"dyn_array iterators must be random access");
+static_assert(std::is_same<
+		decltype(std::declval<const element_list&>().begin().node()),
+		const element*>::value,
+		"nodes of a const circular_list must be const");
+
+// Checks that LIST holds exactly the ids of IDS in order, in both directions
+static int check_list(const element_list &list, const char *ids) {
+	const element *head, *node;
+	size_t n = 0;
+
+	for(const element &node : list) {
+		tassert(ids[n] == node.id);
+		n++;
+	}
+	tassert(ids[n] == '\0');
+	tassert(list.size() == n);
+
+	for(element_list::const_reverse_iterator it = list.rbegin();
+			it != list.rend(); ++it) {
+		n--;
+		tassert(ids[n] == it->id);
+	}
+	tassert(n == 0);
+
+	// the links are the same as those of the list.h macros
+	head = list.head();
+	list_foreach(&head, node) {
+		tassert(ids[n] == node->id);
+		n++;
+	}
+	tassert(ids[n] == '\0');
+
+	return 0;
+}
+
+int test_list_push_pop() {
+	element nodes[4] = {};
+	element_list list;
+	int i;
+
+	for(i = 0; i < 4; i++) nodes[i].id = 'a' + i;
+
+	tassert(list.empty());
+	tassert(list.begin() == list.end());
+	tassert(list.size() == 0);
+	tassert(check_list(list, "") == 0);
+
+	list.push_back(nodes[1]);
+	list.push_back(nodes[2]);
+	list.push_front(nodes[0]);
+	list.push_back(nodes[3]);
+	tassert(!list.empty());
+	tassert(list.front().id == 'a');
+	tassert(list.back().id == 'd');
+	tassert(check_list(list, "abcd") == 0);
+
+	list.pop_front();
+	tassert(check_list(list, "bcd") == 0);
+	list.pop_back();
+	tassert(check_list(list, "bc") == 0);
+	list.remove(nodes[2]);
+	tassert(check_list(list, "b") == 0);
+	list.pop_back();
+	tassert(list.empty());
+	tassert(list.head() == nullptr);
+
+	return 0;
+}
+
+int test_list_insert_erase() {
+	element nodes[5] = {};
+	element_list list;
+	element_list::iterator it;
+	int i;
+
+	for(i = 0; i < 5; i++) nodes[i].id = 'a' + i;
+
+	it = list.insert(list.end(), nodes[2]);
+	tassert(it->id == 'c');
+	list.insert(list.begin(), nodes[0]);
+	list.insert(list.end(), nodes[4]);
+	it = std::find_if(list.begin(), list.end(),
+			[](const element &e) { return e.id == 'c'; });
+	list.insert(it, nodes[1]);
+	list.insert(std::prev(list.end()), nodes[3]);
+	tassert(check_list(list, "abcde") == 0);
+
+	// erase every other node the way std::list would be walked
+	for(it = list.begin(); it != list.end(); ) {
+		if((it->id - 'a') % 2 == 0) {
+			it = list.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	tassert(check_list(list, "bd") == 0);
+
+	it = list.erase(std::next(list.begin()));
+	tassert(it == list.end());
+	it = list.erase(list.begin());
+	tassert(it == list.end());
+	tassert(list.empty());
+
+	return 0;
+}
+
+int test_list_iterator_validity() {
+	element nodes[5] = {};
+	element_list list;
+	element_list::iterator it;
+	element_list::const_iterator cit;
+	int i;
+
+	for(i = 0; i < 5; i++) {
+		nodes[i].id = 'a' + i;
+		if(i > 0 && i < 4) list.push_back(nodes[i]);
+	}
+
+	// iterators taken before the head changes still find the end
+	it = std::next(list.begin());
+	cit = std::next(list.cbegin(), 2);
+	list.erase(list.begin());
+	tassert(it->id == 'c');
+	tassert(std::distance(it, list.end()) == 2);
+	tassert(std::distance(cit, list.cend()) == 1);
+
+	list.push_front(nodes[0]);
+	list.push_back(nodes[4]);
+	tassert(std::distance(it, list.end()) == 3);
+	tassert(std::prev(list.end())->id == 'e');
+	tassert(check_list(list, "acde") == 0);
+
+	list.pop_front();
+	tassert(std::distance(list.begin(), it) == 0);
+	tassert(std::distance(cit, list.cend()) == 2);
+	tassert(check_list(list, "cde") == 0);
+
+	return 0;
+}
+
+int test_list_custom_links() {
+	link_element nodes[8] = {};
+	link_list list;
+	link_element *head;
+	int i, sum;
+
+	for(i = 0; i < 8; i++) {
+		nodes[i].value = i;
+		list.push_back(nodes[i]);
+	}
+
+	tassert(std::distance(list.begin(), list.end()) == 8);
+	sum = 0;
+	for(link_element &e : list) sum += e.value;
+	tassert(sum == 28);
+	tassert(std::prev(list.end())->value == 7);
+	tassert(list.front().left == &nodes[7]);
+	tassert(nodes[7].right == &nodes[0]);
+
+	// the reverse iteration wraps around the same way as the forward one
+	i = 7;
+	for(link_list::reverse_iterator it = list.rbegin(); it != list.rend();
+			++it) {
+		tassert(it->value == i);
+		i--;
+	}
+	tassert(i == -1);
+
+	head = list.head();
+	list.remove(nodes[0]);
+	tassert(list.head() == &nodes[1]);
+	tassert(head->value == 0);
+	tassert(nodes[7].right == &nodes[1]);
+
+	return 0;
+}
+
+int test_list_move_splice() {
+	element nodes[6] = {};
+	element_list a, b;
+	element *head;
+	int i;
+
+	for(i = 0; i < 6; i++) {
+		nodes[i].id = 'a' + i;
+		(i < 3 ? a : b).push_back(nodes[i]);
+	}
+
+	a.splice_back(b);
+	tassert(b.empty());
+	tassert(check_list(a, "abcdef") == 0);
+	a.splice_back(b);
+	tassert(check_list(a, "abcdef") == 0);
+	b.splice_back(a);
+	tassert(a.empty());
+	tassert(check_list(b, "abcdef") == 0);
+
+	// splicing a list onto itself changes nothing
+	b.splice_back(b);
+	tassert(check_list(b, "abcdef") == 0);
+
+	element_list c(std::move(b));
+	tassert(b.empty());
+	tassert(check_list(c, "abcdef") == 0);
+	a = std::move(c);
+	tassert(c.empty());
+	a.swap(c);
+	tassert(a.empty());
+	tassert(check_list(c, "abcdef") == 0);
+
+	// no nodes get lost by moving, not even onto the same list
+	c = std::move(*&c);
+	tassert(check_list(c, "abcdef") == 0);
+	c.pop_front();
+	a.push_back(nodes[0]);
+	a = std::move(c);
+	tassert(check_list(a, "bcdef") == 0);
+	tassert(check_list(c, "a") == 0);
+	c.pop_front();
+	a.push_front(nodes[0]);
+	c.swap(a);
+
+	// the head is shared with the list.h macros
+	list_remove(&c.head(), &nodes[0]);
+	tassert(check_list(c, "bcdef") == 0);
+	head = nullptr;
+	list_append(&head, &nodes[0]);
+	element_list d(head);
+	tassert(check_list(d, "a") == 0);
+
+	return 0;
+}
+
+int test_dyn_array_push() {
+	dyn_array<int> a;
+	int i;
+
+	tassert(a.empty());
+	tassert(a.size() == 0);
+	tassert(a.capacity() == 0);
+	tassert(a.begin() == a.end());
+	tassert(a.get() == nullptr);
+
+	for(i = 0; i < 1000; i++) a.push_back(i);
+	tassert(a.size() == 1000);
+	tassert(a.capacity() >= 1000);
+	tassert(a.front() == 0);
+	tassert(a.back() == 999);
+	tassert(std::accumulate(a.begin(), a.end(), 0L) == 499500);
+	for(i = 0; i < 1000; i++) tassert(a[i] == i);
+	tassert(array_len(a.get()) == 1000);
+
+	a.pop_back();
+	tassert(a.size() == 999);
+	tassert(a.back() == 998);
+	tassert(a.emplace_back(7) == 7);
+	tassert(a.size() == 1000);
+
+	tassert(a.at(999) == 7);
+	try {
+		a.at(1000);
+		tassert(false);
+	}
+	catch(const std::out_of_range&) {}
+
+	a.clear();
+	tassert(a.empty());
+	tassert(a.capacity() >= 1000);
+
+	return 0;
+}
+
+int test_dyn_array_resize_reserve() {
+	dyn_array<long> a;
+	int i;
+
+	a.reserve(100);
+	tassert(a.capacity() >= 100);
+	tassert(a.size() == 0);
+	a.resize(50);
+	tassert(a.size() == 50);
+	for(i = 0; i < 50; i++) tassert(a[i] == 0);
+	a[10] = 5;
+	a.resize(20);
+	tassert(a.size() == 20);
+	tassert(a[10] == 5);
+	a.resize(0);
+	tassert(a.empty());
+
+	return 0;
+}
+
+int test_dyn_array_algorithms() {
+	dyn_array<int> a;
+	int i, previous;
+
+	for(i = 0; i < 500; i++) a.push_back((i * 7919) % 500);
+	std::sort(a.begin(), a.end());
+	for(i = 0; i < 500; i++) tassert(a[i] == i);
+
+	std::reverse(a.begin(), a.end());
+	tassert(a.front() == 499);
+	tassert(*std::lower_bound(a.rbegin(), a.rend(), 250) == 250);
+
+	previous = -1;
+	for(int e : a) {
+		tassert(previous == -1 || e == previous - 1);
+		previous = e;
+	}
+
+	return 0;
+}
+
+int test_dyn_array_ownership() {
+	dyn_array<int> a, c;
+	int *raw;
+	int i;
+
+	for(i = 0; i < 10; i++) a.push_back(i);
+
+	dyn_array<int> b(a);
+	tassert(b.size() == 10);
+	tassert(b.get() != a.get());
+	tassert(std::equal(a.begin(), a.end(), b.begin()));
+
+	c = std::move(a);
+	tassert(a.get() == nullptr);
+	tassert(a.size() == 0);
+	tassert(c.size() == 10);
+	a.push_back(1);
+	tassert(a.size() == 1);
+
+	a = c;
+	tassert(a.size() == 10);
+	tassert(std::equal(a.begin(), a.end(), c.begin()));
+
+	// release and adopt arrays of the list.h macros
+	raw = c.release();
+	tassert(c.get() == nullptr);
+	array_append(raw, 10);
+	tassert(array_len(raw) == 11);
+	dyn_array<int> d(raw);
+	tassert(d.size() == 11);
+	tassert(d.back() == 10);
+
+	raw = nullptr;
+	array_new(&raw, int);
+	array_append(raw, 3);
+	d = dyn_array<int>(raw);
+	tassert(d.size() == 1);
+	tassert(d[0] == 3);
+
+	return 0;
+}
+
+int test_dyn_array_out_of_memory() {
+	dyn_array<int> a, b;
+	int i;
+
+	for(i = 0; i < 100; i++) a.push_back(i);
+
+	test_alloc_limit = 4096;
+	try {
+		a.reserve(100000);
+		tassert(false);
+	}
+	catch(const std::bad_alloc&) {}
+	tassert(a.size() == 100 && a[99] == 99);
+
+	// the elements that fit stay in the array
+	try {
+		for(i = 100; i < 100000; i++) a.push_back(i);
+		tassert(false);
+	}
+	catch(const std::bad_alloc&) {}
+	tassert(a.size() > 100 && a.size() < 100000);
+	tassert(a.back() == (int) a.size() - 1);
+
+	// the first allocation of the array fails as well
+	test_alloc_limit = 16;
+	try {
+		b.push_back(1);
+		tassert(false);
+	}
+	catch(const std::bad_alloc&) {}
+	tassert(b.get() == nullptr && b.empty());
+	test_alloc_limit = 0;
+
+	b.push_back(1);
+	tassert(b.size() == 1);
+
+	return 0;
+}
+
+int main() {
+	int i, num_tests, failures;
+
+	struct test tests[] = {
+		declare_test(test_list_push_pop),
+		declare_test(test_list_insert_erase),
+		declare_test(test_list_iterator_validity),
+		declare_test(test_list_custom_links),
+		declare_test(test_list_move_splice),
+		declare_test(test_dyn_array_push),
+		declare_test(test_dyn_array_resize_reserve),
+		declare_test(test_dyn_array_algorithms),
+		declare_test(test_dyn_array_ownership),
+		declare_test(test_dyn_array_out_of_memory),
+	};
+
+	num_tests = sizeof(tests) / sizeof(struct test);
+
+	failures = 0;
+	for(i = 0; i < num_tests; i++) {
+		printf("Running test '%s' (%d of %d)...\n", tests[i].name,
+				i + 1, num_tests);
+		if(tests[i].func() != 0) {
+			printf("Test %d failed!\n\n", i + 1);
+			failures++;
+		}
+	}
+
+	printf("\nCompleted %d tests with %d errors.\n", num_tests, failures);
+
+	return 0;
+}